@@ -10,6 +10,62 @@
 #include <memory>
 #include <algorithm>
 #include <execution>
+#include <iomanip>
+#include <cstdlib>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <array>
+#include <map>
+#include <tuple>
+#include <cerrno>
+#include <charconv>
+#include <string_view>
+#include <cctype>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <exception>
+#include <stdexcept>
+#include <random>
+#include <cmath>
+#include <bit>
+#include <type_traits>
+#include <limits>
+
+#if __has_include(<tbb/parallel_for.h>)
+#define BLAZING_HAS_TBB 1
+#include <tbb/parallel_for.h>
+#endif
+
+// C++20: корутинный конвейер (PIPELINE); в C++17-сборках он просто выключен
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define BLAZING_HAS_COROUTINES 1
+#include <coroutine>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BLAZING_HAS_POSIX_IO 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <csignal>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BLAZING_HAS_IO_URING 1
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 
 // BLAZING FAST типы и структуры 🚀
 using namespace std::chrono;
@@ -36,302 +92,6325 @@ struct UserSoA {
         names.push_back(name);
         ages.push_back(age);
     }
+
+    size_t size() const { return ids.size(); }
+
+    /// Растит все колонки разом - параллельные загрузчики пишут в свои строки
+    void resize(size_t count) {
+        ids.resize(count);
+        names.resize(count);
+        ages.resize(count);
+    }
+
+    // Интерфейс раскладки (см. UserPacked / UserAoSoA)
+    int64_t id(size_t row) const { return ids[row]; }
+    uint8_t age(size_t row) const { return ages[row]; }
+    std::string_view name(size_t row) const { return names[row]; }
+
+    template <typename Visitor>
+    void visit_age_runs(size_t begin, size_t end, Visitor&& visit) const {
+        if (begin < end) visit(ages.data() + begin, end - begin, size_t(1));
+    }
 };
 
-/// SIMD BLAZING FAST VERSION 🔥⚡
-inline uint64_t sum_u8_simd(const std::vector<uint8_t>& data) {
-    uint64_t sum = 0;
-    const size_t len = data.size();
-    const uint8_t* ptr = data.data();
-    
-    // Обрабатываем по 8 элементов
-    for (size_t i = 0; i + 8 <= len; i += 8) {
-        for (int j = 0; j < 8; ++j) {
-            sum += ptr[i + j];
+/// РАСКЛАДКИ - кроме AoS/SoA ещё упакованный AoS и AoSoA-плитки 🧱
+/// Общий интерфейс доступа к строкам (UserSoA, UserPacked, UserAoSoA):
+///   size(), id(row), age(row), name(row)
+///   visit_age_runs(begin, end, f) - f(const uint8_t* ages, size_t count, size_t stride)
+///   по отрезкам строк [begin, end); stride - шаг между возрастами в байтах.
+/// Ядра sum_ages / count_ages_in_range / age_histogram работают с любой из них.
+
+/// PACKED AoS: id, возраст и имя в одной 32-байтной записи - без кучи и паддинга
+constexpr size_t PACKED_NAME_CAPACITY = 22;
+
+struct PackedUser {
+    int64_t id;
+    uint8_t age;
+    uint8_t name_len;
+    char name[PACKED_NAME_CAPACITY]; // длиннее - обрезается
+
+    std::string_view name_view() const { return std::string_view(name, name_len); }
+};
+static_assert(sizeof(PackedUser) == 32, "PackedUser is two records per cache line");
+
+class UserPacked {
+private:
+    std::vector<PackedUser> users;
+
+public:
+    void reserve(size_t capacity) { users.reserve(capacity); }
+
+    void add_user(int64_t id, std::string_view name, uint8_t age) {
+        PackedUser user{};
+        user.id = id;
+        user.age = age;
+        user.name_len = static_cast<uint8_t>(std::min(name.size(), PACKED_NAME_CAPACITY));
+        std::memcpy(user.name, name.data(), user.name_len);
+        users.push_back(user);
+    }
+
+    size_t size() const { return users.size(); }
+    int64_t id(size_t row) const { return users[row].id; }
+    uint8_t age(size_t row) const { return users[row].age; }
+    std::string_view name(size_t row) const { return users[row].name_view(); }
+    const PackedUser& operator[](size_t row) const { return users[row]; }
+
+    template <typename Visitor>
+    void visit_age_runs(size_t begin, size_t end, Visitor&& visit) const {
+        if (begin < end) visit(&users[begin].age, end - begin, sizeof(PackedUser));
+    }
+
+    static UserPacked from(const UserSoA& soa) {
+        UserPacked packed;
+        packed.reserve(soa.size());
+        for (size_t i = 0; i < soa.size(); ++i) {
+            packed.add_user(soa.ids[i], soa.names[i], soa.ages[i]);
         }
+        return packed;
     }
-    
-    // Остальные элементы
-    for (size_t i = (len / 8) * 8; i < len; ++i) {
-        sum += ptr[i];
+};
+
+/// AoSoA: плитки по 64 строки, внутри плитки - колонки. Скан возрастов читает одну
+/// кэш-линию на плитку, а вся строка лежит внутри одной 2KB плитки.
+constexpr size_t AOSOA_TILE_ROWS = 64;
+
+struct alignas(64) UserTile {
+    int64_t ids[AOSOA_TILE_ROWS];
+    uint8_t ages[AOSOA_TILE_ROWS];
+    uint8_t name_lens[AOSOA_TILE_ROWS];
+    char names[AOSOA_TILE_ROWS][PACKED_NAME_CAPACITY];
+};
+static_assert(sizeof(UserTile) == 2048, "UserTile layout");
+
+class UserAoSoA {
+private:
+    std::vector<UserTile> tiles;
+    size_t rows = 0;
+
+public:
+    void reserve(size_t capacity) { tiles.reserve((capacity + AOSOA_TILE_ROWS - 1) / AOSOA_TILE_ROWS); }
+
+    void add_user(int64_t id, std::string_view name, uint8_t age) {
+        if (rows % AOSOA_TILE_ROWS == 0) tiles.emplace_back();
+        UserTile& tile = tiles.back();
+        const size_t slot = rows % AOSOA_TILE_ROWS;
+        tile.ids[slot] = id;
+        tile.ages[slot] = age;
+        tile.name_lens[slot] = static_cast<uint8_t>(std::min(name.size(), PACKED_NAME_CAPACITY));
+        std::memcpy(tile.names[slot], name.data(), tile.name_lens[slot]);
+        ++rows;
     }
-    
-    return sum;
-}
 
-/// ULTRA FAST UNSAFE VERSION ⚡🌌
-inline uint64_t sum_u8_ultra_fast(const std::vector<uint8_t>& data) {
-    if (data.empty()) return 0;
-    
-    uint64_t sum = 0;
-    const size_t len = data.size();
-    const uint8_t* ptr = data.data();
-    
-    // Обрабатываем по 8 байт (uint64_t) за раз
-    const size_t chunks = len / 8;
-    const uint64_t* u64_ptr = reinterpret_cast<const uint64_t*>(ptr);
-    
-    for (size_t i = 0; i < chunks; ++i) {
-        uint64_t chunk = u64_ptr[i];
-        
-        // Быстрое извлечение всех байтов
-        sum += (chunk & 0xFF) +
-               ((chunk >> 8) & 0xFF) +
-               ((chunk >> 16) & 0xFF) +
-               ((chunk >> 24) & 0xFF) +
-               ((chunk >> 32) & 0xFF) +
-               ((chunk >> 40) & 0xFF) +
-               ((chunk >> 48) & 0xFF) +
-               ((chunk >> 56) & 0xFF);
+    size_t size() const { return rows; }
+    int64_t id(size_t row) const { return tiles[row / AOSOA_TILE_ROWS].ids[row % AOSOA_TILE_ROWS]; }
+    uint8_t age(size_t row) const { return tiles[row / AOSOA_TILE_ROWS].ages[row % AOSOA_TILE_ROWS]; }
+    std::string_view name(size_t row) const {
+        const UserTile& tile = tiles[row / AOSOA_TILE_ROWS];
+        const size_t slot = row % AOSOA_TILE_ROWS;
+        return std::string_view(tile.names[slot], tile.name_lens[slot]);
     }
-    
-    // Обрабатываем оставшиеся байты
-    for (size_t i = chunks * 8; i < len; ++i) {
-        sum += ptr[i];
+
+    template <typename Visitor>
+    void visit_age_runs(size_t begin, size_t end, Visitor&& visit) const {
+        while (begin < end) {
+            const size_t slot = begin % AOSOA_TILE_ROWS;
+            const size_t count = std::min(end - begin, AOSOA_TILE_ROWS - slot);
+            visit(tiles[begin / AOSOA_TILE_ROWS].ages + slot, count, size_t(1));
+            begin += count;
+        }
     }
-    
-    return sum;
-}
 
-/// AVX2 BLAZING VERSION - 256-битные векторы! 🌊⚡
-inline uint64_t sum_u8_avx2(const std::vector<uint8_t>& data) {
-    if (data.empty()) return 0;
-    
-    uint64_t sum = 0;
-    const size_t len = data.size();
-    const uint8_t* ptr = data.data();
-    
-    #ifdef __AVX2__
-    // AVX2: обрабатываем по 32 байта
-    const size_t avx_chunks = len / 32;
-    __m256i acc = _mm256_setzero_si256();
-    
-    for (size_t i = 0; i < avx_chunks; ++i) {
-        __m256i data_vec = _mm256_loadu_si256(
-            reinterpret_cast<const __m256i*>(ptr + i * 32));
-        
-        // Преобразуем в 16-битные значения и накапливаем
-        __m256i low = _mm256_unpacklo_epi8(data_vec, _mm256_setzero_si256());
-        __m256i high = _mm256_unpackhi_epi8(data_vec, _mm256_setzero_si256());
-        
-        acc = _mm256_add_epi16(acc, low);
-        acc = _mm256_add_epi16(acc, high);
+    static UserAoSoA from(const UserSoA& soa) {
+        UserAoSoA tiled;
+        tiled.reserve(soa.size());
+        for (size_t i = 0; i < soa.size(); ++i) {
+            tiled.add_user(soa.ids[i], soa.names[i], soa.ages[i]);
+        }
+        return tiled;
     }
-    
-    // Горизонтальное суммирование
-    __m128i sum128 = _mm_add_epi16(_mm256_extracti128_si256(acc, 0),
-                                   _mm256_extracti128_si256(acc, 1));
-    
-    // Извлекаем результат
-    alignas(16) int16_t results[8];
-    _mm_store_si128(reinterpret_cast<__m128i*>(results), sum128);
-    
-    for (int i = 0; i < 8; ++i) {
-        sum += results[i];
+};
+
+/// CHUNKED COLUMNS - колонка из сегментов фиксированного размера, выровненных по кэш-линии 🧩
+/// Рост добавляет сегмент и ничего не копирует: нет огромного reserve заранее и нет
+/// пиков памяти при переезде вектора. Память следует за числом строк с точностью до сегмента.
+constexpr size_t COLUMN_CHUNK_ROWS = 64 * 1024;
+
+template <typename T>
+class ChunkedColumn {
+private:
+    struct alignas(64) Segment {
+        T values[COLUMN_CHUNK_ROWS];
+    };
+
+    std::vector<std::unique_ptr<Segment>> segments;
+    size_t rows = 0;
+
+public:
+    void push_back(T value) {
+        if (rows % COLUMN_CHUNK_ROWS == 0) segments.push_back(std::make_unique<Segment>());
+        segments.back()->values[rows % COLUMN_CHUNK_ROWS] = std::move(value);
+        ++rows;
     }
-    
-    // Обрабатываем оставшиеся байты
-    for (size_t i = avx_chunks * 32; i < len; ++i) {
-        sum += ptr[i];
+
+    size_t size() const { return rows; }
+    T& operator[](size_t row) { return segments[row / COLUMN_CHUNK_ROWS]->values[row % COLUMN_CHUNK_ROWS]; }
+    const T& operator[](size_t row) const { return segments[row / COLUMN_CHUNK_ROWS]->values[row % COLUMN_CHUNK_ROWS]; }
+
+    size_t chunk_count() const { return segments.size(); }
+    const T* chunk_data(size_t chunk) const { return segments[chunk]->values; }
+    size_t chunk_rows(size_t chunk) const {
+        return chunk + 1 < segments.size() ? COLUMN_CHUNK_ROWS : rows - chunk * COLUMN_CHUNK_ROWS;
     }
-    #else
-    // Fallback без AVX2
-    return sum_u8_ultra_fast(data);
-    #endif
-    
-    return sum;
-}
 
-/// GODLIKE VERSION - 64-байтовые чанки! 👑⚡
-inline uint64_t sum_u8_godlike(const std::vector<uint8_t>& data) {
-    if (data.empty()) return 0;
-    
-    uint64_t sum = 0;
-    const size_t len = data.size();
-    const uint8_t* ptr = data.data();
-    
-    // Обрабатываем по 64 байта (8 x uint64_t)
-    const size_t chunks_64 = len / 64;
-    const uint64_t* u64_ptr = reinterpret_cast<const uint64_t*>(ptr);
-    
-    for (size_t chunk = 0; chunk < chunks_64; ++chunk) {
-        const size_t base = chunk * 8;
-        
-        // Загружаем 8 uint64_t одновременно
-        uint64_t v1 = u64_ptr[base + 0];
-        uint64_t v2 = u64_ptr[base + 1];
-        uint64_t v3 = u64_ptr[base + 2];
-        uint64_t v4 = u64_ptr[base + 3];
-        uint64_t v5 = u64_ptr[base + 4];
-        uint64_t v6 = u64_ptr[base + 5];
-        uint64_t v7 = u64_ptr[base + 6];
-        uint64_t v8 = u64_ptr[base + 7];
-        
-        // Быстрое извлечение всех байтов
-        auto extract_bytes = [](uint64_t val) -> uint64_t {
-            return (val & 0xFF) + ((val >> 8) & 0xFF) + ((val >> 16) & 0xFF) + 
-                   ((val >> 24) & 0xFF) + ((val >> 32) & 0xFF) + ((val >> 40) & 0xFF) +
-                   ((val >> 48) & 0xFF) + ((val >> 56) & 0xFF);
+    size_t allocated_bytes() const { return segments.size() * sizeof(Segment); }
+};
+
+/// UserSoA на сегментированных колонках - тот же интерфейс раскладки
+struct ChunkedUserSoA {
+    ChunkedColumn<int64_t> ids;
+    ChunkedColumn<std::string> names;
+    ChunkedColumn<uint8_t> ages;
+
+    void add_user(int64_t id, std::string name, uint8_t age) {
+        ids.push_back(id);
+        names.push_back(std::move(name));
+        ages.push_back(age);
+    }
+
+    size_t size() const { return ids.size(); }
+    int64_t id(size_t row) const { return ids[row]; }
+    uint8_t age(size_t row) const { return ages[row]; }
+    std::string_view name(size_t row) const { return names[row]; }
+
+    template <typename Visitor>
+    void visit_age_runs(size_t begin, size_t end, Visitor&& visit) const {
+        while (begin < end) {
+            const size_t slot = begin % COLUMN_CHUNK_ROWS;
+            const size_t count = std::min(end - begin, COLUMN_CHUNK_ROWS - slot);
+            visit(ages.chunk_data(begin / COLUMN_CHUNK_ROWS) + slot, count, size_t(1));
+            begin += count;
+        }
+    }
+
+    static ChunkedUserSoA from(const UserSoA& soa) {
+        ChunkedUserSoA chunked;
+        for (size_t i = 0; i < soa.size(); ++i) {
+            chunked.add_user(soa.ids[i], soa.names[i], soa.ages[i]);
+        }
+        return chunked;
+    }
+};
+
+/// EPOCH-BASED RECLAMATION - отложенное удаление того, что читатели могли успеть увидеть ♻️
+/// Читатель на время чтения входит в эпоху (EpochGuard). Писатель, заменив указатель,
+/// отдаёт старый объект в retire - он удаляется, когда все активные читатели вошли
+/// в эпоху позже момента retire. Вход и выход - по записи в свой слот, без блокировок.
+constexpr size_t EPOCH_MAX_THREADS = 256;
+
+class EpochDomain {
+private:
+    static constexpr uint64_t QUIESCENT = UINT64_MAX;
+
+    struct alignas(64) ThreadSlot {
+        std::atomic<uint64_t> epoch{QUIESCENT};
+        std::atomic<bool> claimed{false};
+        uint32_t depth = 0; // вложенные guard'ы - трогает только владелец слота
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> destroy;
+    };
+
+    alignas(64) std::atomic<uint64_t> global_epoch{1};
+    ThreadSlot slots[EPOCH_MAX_THREADS];
+    std::mutex retired_mutex;
+    std::vector<Retired> retired;
+
+    /// Слот потока захватывается при первом входе и освобождается при выходе потока
+    ThreadSlot& local_slot() {
+        struct Lease {
+            ThreadSlot* slot = nullptr;
+            ~Lease() {
+                if (slot) slot->claimed.store(false, std::memory_order_release);
+            }
         };
-        
-        sum += extract_bytes(v1) + extract_bytes(v2) + extract_bytes(v3) + extract_bytes(v4) +
-               extract_bytes(v5) + extract_bytes(v6) + extract_bytes(v7) + extract_bytes(v8);
+        thread_local Lease lease;
+        while (!lease.slot) {
+            for (ThreadSlot& slot : slots) {
+                bool expected = false;
+                if (slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    lease.slot = &slot;
+                    break;
+                }
+            }
+            if (!lease.slot) std::this_thread::yield(); // все слоты заняты - ждём выхода потока
+        }
+        return *lease.slot;
     }
-    
-    // Остальные байты
-    for (size_t i = chunks_64 * 64; i < len; ++i) {
-        sum += ptr[i];
+
+public:
+    ~EpochDomain() {
+        for (Retired& item : retired) item.destroy();
     }
-    
-    return sum;
+
+    void enter() {
+        ThreadSlot& slot = local_slot();
+        if (slot.depth++ == 0) {
+            slot.epoch.store(global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void leave() {
+        ThreadSlot& slot = local_slot();
+        if (--slot.depth == 0) slot.epoch.store(QUIESCENT, std::memory_order_release);
+    }
+
+    /// Вызывать после того, как объект стал недостижим для новых читателей
+    void retire(std::function<void()> destroy) {
+        const uint64_t epoch = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex);
+            retired.push_back(Retired{epoch, std::move(destroy)});
+        }
+        reclaim();
+    }
+
+    /// Удаляет всё, что retire'нуто раньше входа самого старого активного читателя
+    void reclaim() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest_active = QUIESCENT;
+        for (const ThreadSlot& slot : slots) {
+            oldest_active = std::min(oldest_active, slot.epoch.load(std::memory_order_seq_cst));
+        }
+
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex);
+            auto still_visible = std::partition(retired.begin(), retired.end(),
+                                                [oldest_active](const Retired& item) { return item.epoch >= oldest_active; });
+            std::move(still_visible, retired.end(), std::back_inserter(ready));
+            retired.erase(still_visible, retired.end());
+        }
+        for (Retired& item : ready) item.destroy();
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(retired_mutex);
+        return retired.size();
+    }
+};
+
+inline EpochDomain& epoch_domain() {
+    static EpochDomain domain;
+    return domain;
 }
 
-/// PARALLEL ULTRA VERSION - многопоточность! 🌟⚡
-uint64_t sum_u8_parallel(const std::vector<uint8_t>& data) {
-    const size_t num_threads = std::thread::hardware_concurrency();
-    const size_t chunk_size = data.size() / num_threads;
-    
-    std::vector<std::future<uint64_t>> futures;
-    
-    for (size_t t = 0; t < num_threads; ++t) {
-        size_t start = t * chunk_size;
-        size_t end = (t == num_threads - 1) ? data.size() : (t + 1) * chunk_size;
-        
-        futures.push_back(std::async(std::launch::async, [&data, start, end]() {
-            std::vector<uint8_t> chunk(data.begin() + start, data.begin() + end);
-            return sum_u8_ultra_fast(chunk);
-        }));
+class EpochGuard {
+public:
+    EpochGuard() { epoch_domain().enter(); }
+    ~EpochGuard() { epoch_domain().leave(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+/// CONCURRENT APPEND - несколько продюсеров пишут в колонки без общего мьютекса 📥⚡
+/// Продюсер резервирует отрезок строк одним fetch_add, заполняет его и публикует.
+/// Публикация двигает водяной знак committed строго по порядку отрезков, поэтому
+/// читатели всегда видят сплошной префикс. Колонки лежат чанками фиксированного
+/// размера; чанки не переезжают, а таблица чанков при росте копируется в новую
+/// вдвое больше, старая уходит в EpochDomain. Мьютекс берётся только на новый чанк.
+constexpr size_t APPEND_CHUNK_ROWS = 64 * 1024;
+
+struct UserChunk {
+    int64_t ids[APPEND_CHUNK_ROWS];
+    uint8_t ages[APPEND_CHUNK_ROWS];
+    std::string names[APPEND_CHUNK_ROWS];
+};
+
+struct UserChunkTable {
+    size_t capacity;
+    std::unique_ptr<std::atomic<UserChunk*>[]> chunks;
+
+    explicit UserChunkTable(size_t capacity) : capacity(capacity), chunks(new std::atomic<UserChunk*>[capacity]) {
+        for (size_t c = 0; c < capacity; ++c) chunks[c].store(nullptr, std::memory_order_relaxed);
     }
-    
-    uint64_t total_sum = 0;
-    for (auto& future : futures) {
-        total_sum += future.get();
+};
+
+struct AppendRange {
+    size_t begin = 0;
+    size_t end = 0;
+
+    size_t size() const { return end - begin; }
+};
+
+class UserStoreSnapshot;
+
+class ConcurrentUserStore {
+private:
+    std::atomic<UserChunkTable*> table;
+    std::mutex grow_mutex;
+    alignas(64) std::atomic<size_t> reserved{0};
+    alignas(64) std::atomic<size_t> committed{0};
+
+    UserChunk* install_chunk(size_t chunk_index) {
+        std::lock_guard<std::mutex> lock(grow_mutex);
+        UserChunkTable* current = table.load(std::memory_order_acquire);
+        if (chunk_index < current->capacity) {
+            if (UserChunk* chunk = current->chunks[chunk_index].load(std::memory_order_acquire)) return chunk;
+        } else {
+            // Копия таблицы с теми же чанками; старую ещё могут читать снапшоты
+            size_t capacity = current->capacity;
+            while (capacity <= chunk_index) capacity *= 2;
+            auto grown = new UserChunkTable(capacity);
+            for (size_t c = 0; c < current->capacity; ++c) {
+                grown->chunks[c].store(current->chunks[c].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            table.store(grown, std::memory_order_seq_cst);
+            epoch_domain().retire([current] { delete current; });
+            current = grown;
+        }
+
+        UserChunk* chunk = new UserChunk();
+        current->chunks[chunk_index].store(chunk, std::memory_order_release);
+        return chunk;
+    }
+
+    UserChunk* chunk_for_write(size_t row) {
+        const size_t chunk_index = row / APPEND_CHUNK_ROWS;
+        {
+            EpochGuard guard;
+            const UserChunkTable* current = table.load(std::memory_order_acquire);
+            if (chunk_index < current->capacity) {
+                if (UserChunk* chunk = current->chunks[chunk_index].load(std::memory_order_acquire)) return chunk;
+            }
+        }
+        return install_chunk(chunk_index);
+    }
+
+    friend class UserStoreSnapshot;
+
+public:
+    explicit ConcurrentUserStore(size_t expected_rows = 0)
+        : table(new UserChunkTable(std::max<size_t>(1, (expected_rows + APPEND_CHUNK_ROWS - 1) / APPEND_CHUNK_ROWS))) {}
+
+    /// Чанки принадлежат хранилищу и все есть в текущей таблице; старые таблицы их не владеют
+    ~ConcurrentUserStore() {
+        UserChunkTable* current = table.load(std::memory_order_acquire);
+        for (size_t c = 0; c < current->capacity; ++c) delete current->chunks[c].load(std::memory_order_relaxed);
+        delete current;
+    }
+
+    ConcurrentUserStore(const ConcurrentUserStore&) = delete;
+    ConcurrentUserStore& operator=(const ConcurrentUserStore&) = delete;
+
+    /// Каждый полученный отрезок обязательно публикуется - иначе водяной знак встанет
+    AppendRange reserve_rows(size_t count) {
+        const size_t begin = reserved.fetch_add(count, std::memory_order_relaxed);
+        return AppendRange{begin, begin + count};
+    }
+
+    void write(size_t row, int64_t id, std::string_view name, uint8_t age) {
+        UserChunk* chunk = chunk_for_write(row);
+        const size_t slot = row % APPEND_CHUNK_ROWS;
+        chunk->ids[slot] = id;
+        chunk->ages[slot] = age;
+        chunk->names[slot].assign(name.data(), name.size());
+    }
+
+    /// Отрезок из source начиная с source_begin; чанк ищется один раз на кусок отрезка в нём
+    void write_rows(const AppendRange& range, const UserSoA& source, size_t source_begin) {
+        for (size_t row = range.begin; row < range.end;) {
+            UserChunk* chunk = chunk_for_write(row);
+            const size_t slot = row % APPEND_CHUNK_ROWS;
+            const size_t count = std::min(range.end - row, APPEND_CHUNK_ROWS - slot);
+            const size_t from = source_begin + (row - range.begin);
+
+            std::memcpy(chunk->ids + slot, source.ids.data() + from, count * sizeof(int64_t));
+            std::memcpy(chunk->ages + slot, source.ages.data() + from, count);
+            for (size_t i = 0; i < count; ++i) {
+                chunk->names[slot + i] = source.names[from + i];
+            }
+            row += count;
+        }
+    }
+
+    /// Ждёт публикации всех предыдущих отрезков и сдвигает водяной знак на свой конец
+    void publish(const AppendRange& range) {
+        while (committed.load(std::memory_order_acquire) != range.begin) {
+            std::this_thread::yield();
+        }
+        committed.store(range.end, std::memory_order_release);
+    }
+
+    /// Пакет целиком: reserve → write → publish. Возвращает число записанных строк.
+    size_t append(const UserSoA& batch) {
+        const AppendRange range = reserve_rows(batch.size());
+        write_rows(range, batch, 0);
+        publish(range);
+        return range.size();
+    }
+
+    size_t size() const { return committed.load(std::memory_order_acquire); }
+
+    UserStoreSnapshot snapshot() const;
+};
+
+/// SNAPSHOT - версия хранилища для читателя: (число строк, таблица чанков), берётся за O(1) 📸
+/// Пока снапшот жив, его таблица не удаляется, а строки [0, size()) уже не меняются -
+/// длинный скан идёт по снапшоту и не мешает продюсерам дописывать новые строки.
+/// Снапшот держит эпоху потока, в котором создан: создавать и разрушать в одном потоке,
+/// сканировать можно с любых (sum_ages и прочие ядра раскладки работают с ним напрямую).
+class UserStoreSnapshot {
+private:
+    EpochGuard guard;
+    size_t rows;
+    const UserChunkTable* table;
+
+    const UserChunk& chunk_for_read(size_t row) const {
+        return *table->chunks[row / APPEND_CHUNK_ROWS].load(std::memory_order_acquire);
+    }
+
+public:
+    // Сначала водяной знак, потом таблица - в ней уже есть все чанки опубликованных строк
+    explicit UserStoreSnapshot(const ConcurrentUserStore& store)
+        : rows(store.committed.load(std::memory_order_acquire)),
+          table(store.table.load(std::memory_order_seq_cst)) {}
+
+    UserStoreSnapshot(const UserStoreSnapshot&) = delete;
+    UserStoreSnapshot& operator=(const UserStoreSnapshot&) = delete;
+
+    // Интерфейс раскладки
+    size_t size() const { return rows; }
+    int64_t id(size_t row) const { return chunk_for_read(row).ids[row % APPEND_CHUNK_ROWS]; }
+    uint8_t age(size_t row) const { return chunk_for_read(row).ages[row % APPEND_CHUNK_ROWS]; }
+    std::string_view name(size_t row) const { return chunk_for_read(row).names[row % APPEND_CHUNK_ROWS]; }
+
+    template <typename Visitor>
+    void visit_age_runs(size_t begin, size_t end, Visitor&& visit) const {
+        while (begin < end) {
+            const size_t slot = begin % APPEND_CHUNK_ROWS;
+            const size_t count = std::min(end - begin, APPEND_CHUNK_ROWS - slot);
+            visit(chunk_for_read(begin).ages + slot, count, size_t(1));
+            begin += count;
+        }
+    }
+
+    /// Копия снапшота в обычные колонки
+    UserSoA to_soa() const {
+        UserSoA soa;
+        soa.reserve(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            soa.add_user(id(i), std::string(name(i)), age(i));
+        }
+        return soa;
+    }
+};
+
+inline UserStoreSnapshot ConcurrentUserStore::snapshot() const {
+    return UserStoreSnapshot(*this);
+}
+
+/// MUTABLE TABLE - удаления битовой картой надгробий, обновления на месте, фоновое уплотнение 🪦🧹
+/// Удаление ставит бит в карте чанка - данные не двигаются, ядра агрегатов маскируют
+/// удалённые строки SIMD-ом. id и возраст меняются на месте. Когда доля удалённых в чанке
+/// переходит порог, фоновый поток переписывает чанк без них вне мьютекса таблицы и под
+/// ним только доносит изменения, сделанные за время копии, и подменяет версию - по чанку
+/// за раз. Старые чанки освобождает EpochDomain, поэтому сканы снапшотов никого не ждут.
+/// Снапшот фиксирует набор чанков и число строк; удаления и обновления на месте
+/// скан видит сразу, построчно.
+constexpr size_t MUTABLE_CHUNK_ROWS = 64 * 1024;
+constexpr size_t TOMBSTONE_WORDS = MUTABLE_CHUNK_ROWS / 64;
+constexpr double DEFAULT_COMPACT_THRESHOLD = 0.25;
+
+struct MutableChunk {
+    uint64_t id = 0;         // номер чанка: переписанный чанк наследует его, порядок id = порядок чанков
+    uint64_t generation = 0; // своя у каждой копии
+    std::atomic<size_t> rows{0};
+    size_t deleted = 0; // под мьютексом таблицы
+    size_t updates = 0; // правки id/возраста на месте, под мьютексом таблицы
+    std::atomic<uint64_t> tombstones[TOMBSTONE_WORDS] = {};
+    alignas(64) uint8_t ages[MUTABLE_CHUNK_ROWS];
+    int64_t ids[MUTABLE_CHUNK_ROWS];
+    std::string names[MUTABLE_CHUNK_ROWS];
+
+    bool is_deleted(size_t slot) const {
+        return (tombstones[slot / 64].load(std::memory_order_relaxed) >> (slot % 64)) & 1;
+    }
+};
+
+/// Адрес строки; после уплотнения её чанка ссылка устаревает (generation не совпадёт).
+/// Чанк ищется по id, а не по позиции - выброшенный пустой чанк не сдвигает ссылки на соседей.
+struct RowRef {
+    uint64_t chunk = 0; // MutableChunk::id
+    size_t slot = 0;
+    uint64_t generation = 0;
+};
+
+struct MutableTableVersion {
+    std::vector<MutableChunk*> chunks;
+};
+
+class MutableUserTable;
+
+class MutableTableSnapshot {
+private:
+    EpochGuard guard;
+    const MutableTableVersion* version;
+    size_t last_chunk_rows;
+
+public:
+    explicit MutableTableSnapshot(const std::atomic<MutableTableVersion*>& current)
+        : version(current.load(std::memory_order_seq_cst)),
+          last_chunk_rows(version->chunks.empty() ? 0 : version->chunks.back()->rows.load(std::memory_order_acquire)) {}
+
+    MutableTableSnapshot(const MutableTableSnapshot&) = delete;
+    MutableTableSnapshot& operator=(const MutableTableSnapshot&) = delete;
+
+    size_t chunk_count() const { return version->chunks.size(); }
+    const MutableChunk& chunk(size_t c) const { return *version->chunks[c]; }
+    RowRef row_ref(size_t c, size_t slot) const {
+        return RowRef{version->chunks[c]->id, slot, version->chunks[c]->generation};
+    }
+    /// Дописывается только последний чанк - его длина взята на момент снапшота
+    size_t chunk_rows(size_t c) const {
+        return c + 1 == version->chunks.size() ? last_chunk_rows : version->chunks[c]->rows.load(std::memory_order_acquire);
+    }
+};
+
+class MutableUserTable {
+private:
+    /// Чанк на уплотнении: снимок его состояния и копия, собранная вне мьютекса
+    struct CompactionJob {
+        MutableChunk* source = nullptr;
+        size_t rows = 0;    // строк на момент снимка
+        size_t updates = 0; // source->updates на момент снимка
+        std::vector<uint64_t> live;        // живые строки снимка - биты [0, rows) без надгробий
+        std::vector<uint32_t> live_before; // живых строк снимка до слова карты
+        std::unique_ptr<MutableChunk> packed;
+    };
+
+    std::atomic<MutableTableVersion*> current;
+    mutable std::mutex mutation_mutex;
+    std::mutex compaction_mutex; // один проход уплотнения за раз; берётся до mutation_mutex
+    std::condition_variable compaction_wakeup;
+    double compact_threshold;
+    bool compaction_requested = false;
+    bool stopping = false;
+    uint64_t next_generation = 1;
+    uint64_t next_chunk_id = 1;
+    size_t compacted_chunks = 0;
+    std::thread compactor;
+
+    MutableChunk* new_chunk() {
+        auto chunk = new MutableChunk();
+        chunk->id = next_chunk_id++;
+        chunk->generation = next_generation++;
+        return chunk;
+    }
+
+    /// Позиция чанка с этим id в версии (id растут по порядку чанков) или chunks.size()
+    static size_t position_of(const MutableTableVersion& version, uint64_t id) {
+        const auto it = std::lower_bound(version.chunks.begin(), version.chunks.end(), id,
+                                         [](const MutableChunk* chunk, uint64_t value) { return chunk->id < value; });
+        return it != version.chunks.end() && (*it)->id == id ? static_cast<size_t>(it - version.chunks.begin())
+                                                             : version.chunks.size();
+    }
+
+    /// Подменяет набор чанков; старая версия и выброшенные чанки уходят в retire
+    void publish_version(std::vector<MutableChunk*> chunks, std::vector<MutableChunk*> dropped) {
+        MutableTableVersion* previous = current.exchange(new MutableTableVersion{std::move(chunks)}, std::memory_order_seq_cst);
+        epoch_domain().retire([previous, dropped = std::move(dropped)] {
+            for (MutableChunk* chunk : dropped) delete chunk;
+            delete previous;
+        });
+    }
+
+    MutableChunk* locate(const RowRef& ref) const {
+        const MutableTableVersion* version = current.load(std::memory_order_acquire);
+        const size_t position = position_of(*version, ref.chunk);
+        if (position == version->chunks.size()) return nullptr;
+        MutableChunk* chunk = version->chunks[position];
+        if (chunk->generation != ref.generation || ref.slot >= chunk->rows.load(std::memory_order_relaxed)) return nullptr;
+        return chunk->is_deleted(ref.slot) ? nullptr : chunk;
+    }
+
+    bool needs_compaction(const MutableChunk& chunk) const {
+        const size_t rows = chunk.rows.load(std::memory_order_relaxed);
+        return chunk.deleted > 0 && chunk.deleted >= compact_threshold * rows;
+    }
+
+    void mark_deleted(MutableChunk& chunk, size_t slot) {
+        chunk.tombstones[slot / 64].fetch_or(uint64_t(1) << (slot % 64), std::memory_order_relaxed);
+        ++chunk.deleted;
+        if (needs_compaction(chunk)) compaction_requested = true;
+    }
+
+    void wake_compactor() {
+        if (compaction_requested && compactor.joinable()) compaction_wakeup.notify_one();
+    }
+
+    /// Копирует живые строки снимка в job.packed; идёт без мьютекса таблицы. Строки
+    /// [0, job.rows) уже не дописываются, имена не меняются, а правки id/возраста
+    /// и новые удаления донесёт finish_compaction.
+    static void pack_chunk(CompactionJob& job) {
+        const MutableChunk& source = *job.source;
+        MutableChunk& packed = *job.packed;
+        size_t out = 0;
+        for (size_t slot = 0; slot < job.rows; ++slot) {
+            if (!((job.live[slot / 64] >> (slot % 64)) & 1)) continue;
+            packed.ids[out] = source.ids[slot];
+            packed.ages[out] = source.ages[slot];
+            packed.names[out] = source.names[slot];
+            ++out;
+        }
+        packed.rows.store(out, std::memory_order_relaxed);
+    }
+
+    /// Под мьютексом: доносит до копии удаления, правки и дописанные с момента снимка
+    /// строки и подменяет в версии чанк-источник копией (пустой - выбрасывает)
+    void finish_compaction(CompactionJob& job) {
+        MutableChunk& source = *job.source;
+        MutableChunk* packed = job.packed.release();
+        size_t out = packed->rows.load(std::memory_order_relaxed);
+
+        // Правки на месте - перечитать фиксированные колонки живых строк снимка
+        if (source.updates != job.updates) {
+            size_t row = 0;
+            for (size_t slot = 0; slot < job.rows; ++slot) {
+                if (!((job.live[slot / 64] >> (slot % 64)) & 1)) continue;
+                packed->ids[row] = source.ids[slot];
+                packed->ages[row] = source.ages[slot];
+                ++row;
+            }
+        }
+
+        // Удалённые после снимка: номер в копии = живые снимка до слова + до бита в слове
+        const size_t snapshot_words = (job.rows + 63) / 64;
+        for (size_t w = 0; w < snapshot_words; ++w) {
+            const uint64_t live = job.live[w];
+            for (uint64_t fresh = source.tombstones[w].load(std::memory_order_relaxed) & live; fresh; fresh &= fresh - 1) {
+                const unsigned bit = static_cast<unsigned>(std::countr_zero(fresh));
+                const size_t row = job.live_before[w] + std::popcount(live & ((uint64_t(1) << bit) - 1));
+                packed->tombstones[row / 64].fetch_or(uint64_t(1) << (row % 64), std::memory_order_relaxed);
+                ++packed->deleted;
+            }
+        }
+
+        // Строки, дописанные в последний чанк за время копии (удалённые сразу отбрасываются)
+        const size_t rows = source.rows.load(std::memory_order_relaxed);
+        for (size_t slot = job.rows; slot < rows; ++slot) {
+            if (source.is_deleted(slot)) continue;
+            packed->ids[out] = source.ids[slot];
+            packed->ages[out] = source.ages[slot];
+            packed->names[out] = source.names[slot];
+            ++out;
+        }
+        packed->rows.store(out, std::memory_order_release);
+        packed->id = source.id;
+        packed->generation = next_generation++;
+
+        const MutableTableVersion* version = current.load(std::memory_order_acquire);
+        std::vector<MutableChunk*> chunks = version->chunks;
+        const size_t position = position_of(*version, source.id);
+        if (out == packed->deleted) {
+            chunks.erase(chunks.begin() + position); // пустой чанк выбрасывается целиком
+            delete packed;
+        } else {
+            chunks[position] = packed;
+            if (needs_compaction(*packed)) compaction_requested = true;
+        }
+        publish_version(std::move(chunks), {&source});
+        ++compacted_chunks;
+    }
+
+    /// Переписывает чанки за порогом только с живыми строками. Под мьютексом таблицы -
+    /// только снимок карт надгробий и подмена каждого чанка; копия строк идёт без него.
+    size_t run_compaction() {
+        std::lock_guard<std::mutex> serial(compaction_mutex);
+
+        std::vector<CompactionJob> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mutation_mutex);
+            for (MutableChunk* chunk : current.load(std::memory_order_acquire)->chunks) {
+                if (!needs_compaction(*chunk)) continue;
+                CompactionJob& job = jobs.emplace_back();
+                job.source = chunk;
+                job.rows = chunk->rows.load(std::memory_order_relaxed);
+                job.updates = chunk->updates;
+                job.live.resize(TOMBSTONE_WORDS);
+                for (size_t w = 0; w < TOMBSTONE_WORDS; ++w) {
+                    job.live[w] = ~chunk->tombstones[w].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Чанки-источники не освобождаются до подмены: их выбрасывает только уплотнение,
+        // а оно идёт под compaction_mutex
+        for (CompactionJob& job : jobs) {
+            job.live_before.resize(TOMBSTONE_WORDS);
+            uint32_t live = 0;
+            for (size_t w = 0; w < TOMBSTONE_WORDS; ++w) {
+                const size_t bits = std::min<size_t>(64, job.rows > w * 64 ? job.rows - w * 64 : 0);
+                job.live[w] &= bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+                job.live_before[w] = live;
+                live += std::popcount(job.live[w]);
+            }
+            job.packed = std::make_unique<MutableChunk>();
+            pack_chunk(job);
+        }
+
+        for (CompactionJob& job : jobs) {
+            std::lock_guard<std::mutex> lock(mutation_mutex);
+            finish_compaction(job);
+        }
+        return jobs.size();
+    }
+
+    void compactor_loop() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutation_mutex);
+                compaction_wakeup.wait(lock, [this] { return stopping || compaction_requested; });
+                if (stopping) break;
+                compaction_requested = false;
+            }
+            run_compaction();
+        }
+    }
+
+public:
+    explicit MutableUserTable(double compact_threshold = DEFAULT_COMPACT_THRESHOLD, bool background_compaction = true)
+        : current(new MutableTableVersion{}), compact_threshold(compact_threshold) {
+        if (background_compaction) compactor = std::thread([this] { compactor_loop(); });
+    }
+
+    ~MutableUserTable() {
+        {
+            std::lock_guard<std::mutex> lock(mutation_mutex);
+            stopping = true;
+        }
+        compaction_wakeup.notify_one();
+        if (compactor.joinable()) compactor.join();
+
+        MutableTableVersion* version = current.load(std::memory_order_acquire);
+        for (MutableChunk* chunk : version->chunks) delete chunk;
+        delete version;
+    }
+
+    MutableUserTable(const MutableUserTable&) = delete;
+    MutableUserTable& operator=(const MutableUserTable&) = delete;
+
+    void append(const UserSoA& batch) {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        for (size_t from = 0; from < batch.size();) {
+            const MutableTableVersion* version = current.load(std::memory_order_acquire);
+            MutableChunk* chunk = version->chunks.empty() ? nullptr : version->chunks.back();
+            if (!chunk || chunk->rows.load(std::memory_order_relaxed) == MUTABLE_CHUNK_ROWS) {
+                std::vector<MutableChunk*> chunks = version->chunks;
+                chunk = new_chunk();
+                chunks.push_back(chunk);
+                publish_version(std::move(chunks), {});
+            }
+
+            const size_t slot = chunk->rows.load(std::memory_order_relaxed);
+            const size_t count = std::min(batch.size() - from, MUTABLE_CHUNK_ROWS - slot);
+            std::memcpy(chunk->ids + slot, batch.ids.data() + from, count * sizeof(int64_t));
+            std::memcpy(chunk->ages + slot, batch.ages.data() + from, count);
+            for (size_t i = 0; i < count; ++i) {
+                chunk->names[slot + i] = batch.names[from + i];
+            }
+            chunk->rows.store(slot + count, std::memory_order_release);
+            from += count;
+        }
+    }
+
+    /// Первая живая строка с таким id (линейный поиск)
+    std::optional<RowRef> find(int64_t id) const {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        const MutableTableVersion* version = current.load(std::memory_order_acquire);
+        for (size_t c = 0; c < version->chunks.size(); ++c) {
+            const MutableChunk& chunk = *version->chunks[c];
+            const size_t rows = chunk.rows.load(std::memory_order_relaxed);
+            for (size_t slot = 0; slot < rows; ++slot) {
+                if (chunk.ids[slot] == id && !chunk.is_deleted(slot)) return RowRef{chunk.id, slot, chunk.generation};
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// false - строка уже удалена или ссылка устарела после уплотнения
+    bool erase(const RowRef& ref) {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        MutableChunk* chunk = locate(ref);
+        if (!chunk) return false;
+        mark_deleted(*chunk, ref.slot);
+        wake_compactor();
+        return true;
+    }
+
+    /// Удаляет живые строки, для которых pred(id, age) истинен; возвращает их число
+    template <typename Predicate>
+    size_t erase_if(Predicate&& pred) {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        size_t erased = 0;
+        for (MutableChunk* chunk : current.load(std::memory_order_acquire)->chunks) {
+            const size_t rows = chunk->rows.load(std::memory_order_relaxed);
+            for (size_t slot = 0; slot < rows; ++slot) {
+                if (!chunk->is_deleted(slot) && pred(chunk->ids[slot], chunk->ages[slot])) {
+                    mark_deleted(*chunk, slot);
+                    ++erased;
+                }
+            }
+        }
+        wake_compactor();
+        return erased;
+    }
+
+    // Обновления фиксированных колонок на месте: скан видит старое или новое значение целиком
+    bool set_age(const RowRef& ref, uint8_t age) {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        MutableChunk* chunk = locate(ref);
+        if (!chunk) return false;
+        std::atomic_ref<uint8_t>(chunk->ages[ref.slot]).store(age, std::memory_order_relaxed);
+        ++chunk->updates;
+        return true;
+    }
+
+    bool set_id(const RowRef& ref, int64_t id) {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        MutableChunk* chunk = locate(ref);
+        if (!chunk) return false;
+        std::atomic_ref<int64_t>(chunk->ids[ref.slot]).store(id, std::memory_order_relaxed);
+        ++chunk->updates;
+        return true;
+    }
+
+    /// Синхронное уплотнение (без фонового потока); возвращает число переписанных чанков
+    size_t compact() {
+        {
+            std::lock_guard<std::mutex> lock(mutation_mutex);
+            compaction_requested = false;
+        }
+        return run_compaction();
+    }
+
+    size_t live_rows() const {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        size_t live = 0;
+        for (const MutableChunk* chunk : current.load(std::memory_order_acquire)->chunks) {
+            live += chunk->rows.load(std::memory_order_relaxed) - chunk->deleted;
+        }
+        return live;
+    }
+
+    size_t compaction_count() const {
+        std::lock_guard<std::mutex> lock(mutation_mutex);
+        return compacted_chunks;
+    }
+
+    MutableTableSnapshot snapshot() const { return MutableTableSnapshot(current); }
+};
+
+/// Колонки без владения: поверх UserSoA или shared memory сегмента
+struct DatasetView {
+    const int64_t* ids = nullptr;
+    const uint8_t* ages = nullptr;
+    size_t rows = 0;
+
+    static DatasetView of(const UserSoA& soa) {
+        return DatasetView{soa.ids.data(), soa.ages.data(), soa.size()};
+    }
+};
+
+/// SIMD BLAZING FAST VERSION 🔥⚡
+inline uint64_t sum_u8_simd(const std::vector<uint8_t>& data) {
+    uint64_t sum = 0;
+    const size_t len = data.size();
+    const uint8_t* ptr = data.data();
+    
+    // Обрабатываем по 8 элементов
+    for (size_t i = 0; i + 8 <= len; i += 8) {
+        for (int j = 0; j < 8; ++j) {
+            sum += ptr[i + j];
+        }
+    }
+    
+    // Остальные элементы
+    for (size_t i = (len / 8) * 8; i < len; ++i) {
+        sum += ptr[i];
+    }
+    
+    return sum;
+}
+
+/// ULTRA FAST UNSAFE VERSION ⚡🌌
+inline uint64_t sum_u8_ultra_fast(const std::vector<uint8_t>& data) {
+    if (data.empty()) return 0;
+    
+    uint64_t sum = 0;
+    const size_t len = data.size();
+    const uint8_t* ptr = data.data();
+    
+    // Обрабатываем по 8 байт (uint64_t) за раз
+    const size_t chunks = len / 8;
+    const uint64_t* u64_ptr = reinterpret_cast<const uint64_t*>(ptr);
+    
+    for (size_t i = 0; i < chunks; ++i) {
+        uint64_t chunk = u64_ptr[i];
+        
+        // Быстрое извлечение всех байтов
+        sum += (chunk & 0xFF) +
+               ((chunk >> 8) & 0xFF) +
+               ((chunk >> 16) & 0xFF) +
+               ((chunk >> 24) & 0xFF) +
+               ((chunk >> 32) & 0xFF) +
+               ((chunk >> 40) & 0xFF) +
+               ((chunk >> 48) & 0xFF) +
+               ((chunk >> 56) & 0xFF);
+    }
+    
+    // Обрабатываем оставшиеся байты
+    for (size_t i = chunks * 8; i < len; ++i) {
+        sum += ptr[i];
+    }
+    
+    return sum;
+}
+
+/// AVX2 BLAZING VERSION - 256-битные векторы! 🌊⚡
+inline uint64_t sum_u8_avx2(const std::vector<uint8_t>& data) {
+    if (data.empty()) return 0;
+    
+    uint64_t sum = 0;
+    const size_t len = data.size();
+    const uint8_t* ptr = data.data();
+    
+    #ifdef __AVX2__
+    // AVX2: обрабатываем по 32 байта
+    const size_t avx_chunks = len / 32;
+    __m256i acc = _mm256_setzero_si256();
+    
+    for (size_t i = 0; i < avx_chunks; ++i) {
+        __m256i data_vec = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(ptr + i * 32));
+        
+        // Преобразуем в 16-битные значения и накапливаем
+        __m256i low = _mm256_unpacklo_epi8(data_vec, _mm256_setzero_si256());
+        __m256i high = _mm256_unpackhi_epi8(data_vec, _mm256_setzero_si256());
+        
+        acc = _mm256_add_epi16(acc, low);
+        acc = _mm256_add_epi16(acc, high);
+    }
+    
+    // Горизонтальное суммирование
+    __m128i sum128 = _mm_add_epi16(_mm256_extracti128_si256(acc, 0),
+                                   _mm256_extracti128_si256(acc, 1));
+    
+    // Извлекаем результат
+    alignas(16) int16_t results[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(results), sum128);
+    
+    for (int i = 0; i < 8; ++i) {
+        sum += results[i];
+    }
+    
+    // Обрабатываем оставшиеся байты
+    for (size_t i = avx_chunks * 32; i < len; ++i) {
+        sum += ptr[i];
+    }
+    #else
+    // Fallback без AVX2
+    return sum_u8_ultra_fast(data);
+    #endif
+    
+    return sum;
+}
+
+/// GODLIKE VERSION - 64-байтовые чанки! 👑⚡
+inline uint64_t sum_u8_godlike(const std::vector<uint8_t>& data) {
+    if (data.empty()) return 0;
+    
+    uint64_t sum = 0;
+    const size_t len = data.size();
+    const uint8_t* ptr = data.data();
+    
+    // Обрабатываем по 64 байта (8 x uint64_t)
+    const size_t chunks_64 = len / 64;
+    const uint64_t* u64_ptr = reinterpret_cast<const uint64_t*>(ptr);
+    
+    for (size_t chunk = 0; chunk < chunks_64; ++chunk) {
+        const size_t base = chunk * 8;
+        
+        // Загружаем 8 uint64_t одновременно
+        uint64_t v1 = u64_ptr[base + 0];
+        uint64_t v2 = u64_ptr[base + 1];
+        uint64_t v3 = u64_ptr[base + 2];
+        uint64_t v4 = u64_ptr[base + 3];
+        uint64_t v5 = u64_ptr[base + 4];
+        uint64_t v6 = u64_ptr[base + 5];
+        uint64_t v7 = u64_ptr[base + 6];
+        uint64_t v8 = u64_ptr[base + 7];
+        
+        // Быстрое извлечение всех байтов
+        auto extract_bytes = [](uint64_t val) -> uint64_t {
+            return (val & 0xFF) + ((val >> 8) & 0xFF) + ((val >> 16) & 0xFF) + 
+                   ((val >> 24) & 0xFF) + ((val >> 32) & 0xFF) + ((val >> 40) & 0xFF) +
+                   ((val >> 48) & 0xFF) + ((val >> 56) & 0xFF);
+        };
+        
+        sum += extract_bytes(v1) + extract_bytes(v2) + extract_bytes(v3) + extract_bytes(v4) +
+               extract_bytes(v5) + extract_bytes(v6) + extract_bytes(v7) + extract_bytes(v8);
+    }
+    
+    // Остальные байты
+    for (size_t i = chunks_64 * 64; i < len; ++i) {
+        sum += ptr[i];
+    }
+    
+    return sum;
+}
+
+/// PARALLEL ULTRA VERSION - многопоточность! 🌟⚡
+uint64_t sum_u8_parallel(const std::vector<uint8_t>& data) {
+    const size_t num_threads = std::thread::hardware_concurrency();
+    const size_t chunk_size = data.size() / num_threads;
+    
+    std::vector<std::future<uint64_t>> futures;
+    
+    for (size_t t = 0; t < num_threads; ++t) {
+        size_t start = t * chunk_size;
+        size_t end = (t == num_threads - 1) ? data.size() : (t + 1) * chunk_size;
+        
+        futures.push_back(std::async(std::launch::async, [&data, start, end]() {
+            std::vector<uint8_t> chunk(data.begin() + start, data.begin() + end);
+            return sum_u8_ultra_fast(chunk);
+        }));
+    }
+    
+    uint64_t total_sum = 0;
+    for (auto& future : futures) {
+        total_sum += future.get();
+    }
+    
+    return total_sum;
+}
+
+/// LUDICROUS SPEED VERSION - параллельный GODLIKE! 🚀⚡🚀
+uint64_t sum_u8_ludicrous_parallel(const std::vector<uint8_t>& data) {
+    const size_t num_threads = std::thread::hardware_concurrency();
+    const size_t chunk_size = data.size() / num_threads;
+    
+    std::vector<std::future<uint64_t>> futures;
+    
+    for (size_t t = 0; t < num_threads; ++t) {
+        size_t start = t * chunk_size;
+        size_t end = (t == num_threads - 1) ? data.size() : (t + 1) * chunk_size;
+        
+        futures.push_back(std::async(std::launch::async, [&data, start, end]() {
+            std::vector<uint8_t> chunk(data.begin() + start, data.begin() + end);
+            return sum_u8_godlike(chunk);
+        }));
+    }
+    
+    uint64_t total_sum = 0;
+    for (auto& future : futures) {
+        total_sum += future.get();
+    }
+    
+    return total_sum;
+}
+
+/// STL PARALLEL VERSION - std::execution! 🔥📚
+uint64_t sum_u8_stl_parallel(const std::vector<uint8_t>& data) {
+    // C++17 parallel algorithms
+    return std::transform_reduce(
+        std::execution::par_unseq,
+        data.begin(), data.end(),
+        0ULL,
+        std::plus<uint64_t>{},
+        [](uint8_t val) { return static_cast<uint64_t>(val); }
+    );
+}
+
+/// THREAD POOL - фиксированный набор потоков и общая очередь задач 🧵
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable has_work;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+
+    void worker_loop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                has_work.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency()) {
+        num_threads = std::max<size_t>(1, num_threads);
+        workers.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        has_work.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        has_work.notify_one();
+    }
+
+    /// Выполнить одну задачу из очереди в текущем потоке; false - очередь пуста
+    bool run_pending_task() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    size_t size() const { return workers.size(); }
+};
+
+inline ThreadPool& default_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+/// PARALLEL BACKENDS - один интерфейс параллельной редукции поверх разных рантаймов ⚙️⚡
+/// Диапазон [0, len) режется на width полос (как в PARALLEL), каждая сворачивается
+/// body(begin, end) в слот своей полосы, слоты сливаются combine. Рантайм выбирается
+/// PARALLEL_BACKEND=async|pool|openmp|tbb|std, число полос - PARALLEL_THREADS.
+enum class ParallelBackend {
+    Async,        // std::async на каждую полосу
+    Pool,         // общий ThreadPool
+    OpenMP,       // #pragma omp parallel for
+    TBB,          // tbb::parallel_for
+    StdExecution, // std::for_each(std::execution::par)
+};
+
+inline const char* parallel_backend_name(ParallelBackend backend) {
+    switch (backend) {
+        case ParallelBackend::Async: return "async";
+        case ParallelBackend::Pool: return "pool";
+        case ParallelBackend::OpenMP: return "openmp";
+        case ParallelBackend::TBB: return "tbb";
+        case ParallelBackend::StdExecution: return "std";
+    }
+    return "async";
+}
+
+/// Бэкенды, под которые собран бинарник
+inline std::vector<ParallelBackend> available_parallel_backends() {
+    std::vector<ParallelBackend> backends = {ParallelBackend::Async, ParallelBackend::Pool};
+    #ifdef _OPENMP
+    backends.push_back(ParallelBackend::OpenMP);
+    #endif
+    #ifdef BLAZING_HAS_TBB
+    backends.push_back(ParallelBackend::TBB);
+    #endif
+    backends.push_back(ParallelBackend::StdExecution);
+    return backends;
+}
+
+/// Неизвестный или не собранный бэкенд - Async
+inline ParallelBackend parallel_backend_from_name(std::string_view name) {
+    for (ParallelBackend backend : available_parallel_backends()) {
+        if (name == parallel_backend_name(backend)) return backend;
+    }
+    return ParallelBackend::Async;
+}
+
+struct ParallelConfig {
+    ParallelBackend backend = ParallelBackend::Async;
+    size_t width = 1; // число полос
+};
+
+inline ParallelConfig& parallel_config() {
+    static ParallelConfig config = [] {
+        ParallelConfig c;
+        if (const char* env_backend = std::getenv("PARALLEL_BACKEND")) c.backend = parallel_backend_from_name(env_backend);
+        c.width = std::max<size_t>(1, std::thread::hardware_concurrency());
+        if (const char* env_threads = std::getenv("PARALLEL_THREADS")) c.width = std::max<size_t>(1, std::stoull(env_threads));
+        return c;
+    }();
+    return config;
+}
+
+/// Размер кэш-линии: слоты разных воркеров никогда не делят линию (нет false sharing)
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) PaddedSlot {
+    T value;
+};
+
+/// Слот-аккумулятор на каждого воркера и детерминированное дерево слияния:
+/// (0,1) (2,3) ..., затем (0,2) (4,6) ... - порядок фиксирован и не зависит от того,
+/// кто и когда закончил, поэтому и double-агрегаты побитово повторяются от запуска к запуску.
+template <typename T>
+class PerWorkerAccumulators {
+private:
+    std::vector<PaddedSlot<T>> slots;
+
+public:
+    PerWorkerAccumulators(size_t workers, const T& identity)
+        : slots(std::max<size_t>(1, workers), PaddedSlot<T>{identity}) {}
+
+    T& operator[](size_t worker) { return slots[worker].value; }
+    const T& operator[](size_t worker) const { return slots[worker].value; }
+    size_t size() const { return slots.size(); }
+
+    /// Сливает слоты на месте; после вызова аккумуляторы использовать нельзя
+    template <typename Combine>
+    T reduce(Combine&& combine) {
+        for (size_t stride = 1; stride < slots.size(); stride *= 2) {
+            for (size_t i = 0; i + stride < slots.size(); i += 2 * stride) {
+                slots[i].value = combine(std::move(slots[i].value), slots[i + stride].value);
+            }
+        }
+        return std::move(slots[0].value);
+    }
+};
+
+/// Все бэкенды пишут результат полосы t в слот t и сливают одним и тем же деревом -
+/// при одинаковом числе полос ответ побитово совпадает для любого бэкенда.
+template <typename T, typename Body, typename Combine>
+T parallel_reduce(size_t len, T identity, Body&& body, Combine&& combine,
+                  const ParallelConfig& config = parallel_config()) {
+    const size_t num_threads = config.width;
+    const size_t chunk_size = len / num_threads;
+
+    PerWorkerAccumulators<T> slots(num_threads, identity);
+    auto run_lane = [&](size_t t) {
+        const size_t start = t * chunk_size;
+        const size_t end = (t == num_threads - 1) ? len : (t + 1) * chunk_size;
+        slots[t] = body(start, end);
+    };
+
+    switch (config.backend) {
+        case ParallelBackend::Pool: {
+            ThreadPool& pool = default_thread_pool();
+            std::mutex mutex;
+            std::condition_variable finished;
+            size_t remaining = num_threads;
+
+            for (size_t t = 0; t < num_threads; ++t) {
+                pool.submit([&, t] {
+                    run_lane(t);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (--remaining == 0) finished.notify_all();
+                });
+            }
+
+            // Ждущий поток сам разбирает очередь пула - так нет дедлока при вызове из задачи пула
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (remaining == 0) break;
+                }
+                if (!pool.run_pending_task()) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    finished.wait(lock, [&] { return remaining == 0; });
+                    break;
+                }
+            }
+            break;
+        }
+
+        #ifdef _OPENMP
+        case ParallelBackend::OpenMP:
+            #pragma omp parallel for num_threads(static_cast<int>(num_threads)) schedule(static)
+            for (int64_t t = 0; t < static_cast<int64_t>(num_threads); ++t) {
+                run_lane(static_cast<size_t>(t));
+            }
+            break;
+        #endif
+
+        #ifdef BLAZING_HAS_TBB
+        case ParallelBackend::TBB:
+            tbb::parallel_for(size_t(0), num_threads, run_lane);
+            break;
+        #endif
+
+        case ParallelBackend::StdExecution: {
+            std::vector<size_t> lanes(num_threads);
+            for (size_t t = 0; t < num_threads; ++t) lanes[t] = t;
+            std::for_each(std::execution::par, lanes.begin(), lanes.end(), run_lane);
+            break;
+        }
+
+        default: {
+            std::vector<std::future<void>> futures;
+            for (size_t t = 0; t < num_threads; ++t) {
+                futures.push_back(std::async(std::launch::async, run_lane, t));
+            }
+            for (auto& future : futures) future.get();
+            break;
+        }
+    }
+
+    return slots.reduce(combine);
+}
+
+/// Дистанция предвыборки по умолчанию (в байтах) для колонок из DRAM
+constexpr size_t DEFAULT_PREFETCH_DISTANCE = 1024;
+
+/// Выбрасываем колонку из всех уровней кэша - честный "холодный" замер 🧊
+inline void evict_from_cache(const std::vector<uint8_t>& data) {
+    const uint8_t* ptr = data.data();
+    for (size_t i = 0; i < data.size(); i += 64) {
+        _mm_clflush(ptr + i);
+    }
+    _mm_mfence();
+}
+
+/// PREFETCH VERSION - программная предвыборка впереди скана! 🧠⚡
+inline uint64_t sum_u8_prefetch_range(const uint8_t* ptr, size_t len, size_t prefetch_distance) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    // По одной кэш-линии (64 байта) за итерацию, _mm256_sad_epu8 копит в 64-битных лейнах
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+
+    for (; i + 64 <= len; i += 64) {
+        _mm_prefetch(reinterpret_cast<const char*>(ptr + i + prefetch_distance), _MM_HINT_T0);
+
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i + 32));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, zero));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(b, zero));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    #else
+    for (; i + 64 <= len; i += 64) {
+        _mm_prefetch(reinterpret_cast<const char*>(ptr + i + prefetch_distance), _MM_HINT_T0);
+        for (size_t j = 0; j < 64; ++j) {
+            sum += ptr[i + j];
+        }
+    }
+    #endif
+
+    // Хвост
+    for (; i < len; ++i) {
+        sum += ptr[i];
+    }
+
+    return sum;
+}
+
+inline uint64_t sum_u8_prefetch(const std::vector<uint8_t>& data,
+                                size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    return sum_u8_prefetch_range(data.data(), data.size(), prefetch_distance);
+}
+
+/// STREAMING VERSION - non-temporal загрузки, не загрязняем кэш! 🌊🧊
+/// prefetchnta тянет линии мимо L2/L3, MOVNTDQA читает их потоково.
+inline uint64_t sum_u8_stream_range(const uint8_t* ptr, size_t len, size_t prefetch_distance) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    // MOVNTDQA требует выравнивания на 32 байта - голову считаем скалярно
+    while (i < len && (reinterpret_cast<uintptr_t>(ptr + i) & 31) != 0) {
+        sum += ptr[i++];
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+
+    for (; i + 64 <= len; i += 64) {
+        _mm_prefetch(reinterpret_cast<const char*>(ptr + i + prefetch_distance), _MM_HINT_NTA);
+
+        __m256i a = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(ptr + i));
+        __m256i b = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(ptr + i + 32));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, zero));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(b, zero));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    #else
+    return sum_u8_prefetch_range(ptr, len, prefetch_distance);
+    #endif
+
+    for (; i < len; ++i) {
+        sum += ptr[i];
+    }
+
+    return sum;
+}
+
+inline uint64_t sum_u8_stream(const std::vector<uint8_t>& data,
+                              size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    return sum_u8_stream_range(data.data(), data.size(), prefetch_distance);
+}
+
+/// PARALLEL PREFETCH VERSION - каждое ядро тянет свою полосу DRAM! 🌟🧠
+uint64_t sum_u8_prefetch_parallel(const uint8_t* ptr, size_t len,
+                                  size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    // Без копирования чанка - работаем прямо по указателю
+    return parallel_reduce(len, uint64_t(0), [ptr, prefetch_distance](size_t start, size_t end) {
+        return sum_u8_prefetch_range(ptr + start, end - start, prefetch_distance);
+    }, std::plus<uint64_t>());
+}
+
+uint64_t sum_u8_prefetch_parallel(const std::vector<uint8_t>& data,
+                                  size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    return sum_u8_prefetch_parallel(data.data(), data.size(), prefetch_distance);
+}
+
+/// Автотюнер дистанции предвыборки: прогоняем кандидатов на холодном срезе 🎯
+/// PREFETCH_DISTANCE в окружении отключает подбор.
+size_t tune_prefetch_distance(const std::vector<uint8_t>& data) {
+    if (const char* env_distance = std::getenv("PREFETCH_DISTANCE")) {
+        return std::stoull(env_distance);
+    }
+
+    // Срез 64MB - заведомо больше LLC, но не весь 100M-столбец
+    const size_t sample_len = std::min<size_t>(data.size(), 64 * 1024 * 1024);
+    if (sample_len < 64 * 1024) return DEFAULT_PREFETCH_DISTANCE;
+
+    const std::vector<uint8_t> sample(data.begin(), data.begin() + sample_len);
+    const size_t candidates[] = {256, 512, 1024, 2048, 4096, 8192};
+
+    size_t best_distance = DEFAULT_PREFETCH_DISTANCE;
+    uint64_t best_nanos = UINT64_MAX;
+    volatile uint64_t sink = 0;
+
+    for (size_t distance : candidates) {
+        evict_from_cache(sample);
+        auto start = high_resolution_clock::now();
+        sink = sink + sum_u8_prefetch(sample, distance);
+        uint64_t nanos = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+
+        if (nanos < best_nanos) {
+            best_nanos = nanos;
+            best_distance = distance;
+        }
+    }
+
+    return best_distance;
+}
+
+/// FILTER VERSION - count(lo <= x <= hi) без ветвлений! 🎯⚡
+inline uint64_t count_u8_in_range(const uint8_t* ptr, size_t len, uint8_t lo, uint8_t hi) {
+    if (lo > hi) return 0;
+
+    uint64_t count = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    // x в [lo, hi]  <=>  (x - lo) <= (hi - lo) без знака  <=>  min(x - lo, hi - lo) == x - lo
+    const __m256i lo_vec = _mm256_set1_epi8(static_cast<char>(lo));
+    const __m256i span_vec = _mm256_set1_epi8(static_cast<char>(hi - lo));
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i shifted = _mm256_sub_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i)), lo_vec);
+        __m256i hits = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, span_vec), shifted);
+        count += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_epi8(hits)));
+    }
+    #endif
+
+    for (; i < len; ++i) {
+        count += static_cast<uint8_t>(ptr[i] - lo) <= static_cast<uint8_t>(hi - lo);
+    }
+
+    return count;
+}
+
+/// HISTOGRAM VERSION - 4 подгистограммы против конфликтов store-to-load 📊⚡
+inline void histogram_u8(const uint8_t* ptr, size_t len, uint64_t* hist) {
+    // Блоками по 1GB - 32-битные счётчики не переполнятся
+    constexpr size_t BLOCK = size_t(1) << 30;
+
+    for (size_t block = 0; block < len; block += BLOCK) {
+        const size_t end = std::min(len, block + BLOCK);
+        uint32_t sub[4][256] = {};
+        size_t i = block;
+
+        for (; i + 4 <= end; i += 4) {
+            ++sub[0][ptr[i]];
+            ++sub[1][ptr[i + 1]];
+            ++sub[2][ptr[i + 2]];
+            ++sub[3][ptr[i + 3]];
+        }
+        for (; i < end; ++i) {
+            ++sub[0][ptr[i]];
+        }
+
+        for (int b = 0; b < 256; ++b) {
+            hist[b] += uint64_t(sub[0][b]) + sub[1][b] + sub[2][b] + sub[3][b];
+        }
+    }
+}
+
+/// PARALLEL FILTER/HISTOGRAM - полосы по ядрам без копирования 🌟🎯
+uint64_t count_u8_in_range_parallel(const uint8_t* ptr, size_t len, uint8_t lo, uint8_t hi) {
+    return parallel_reduce(len, uint64_t(0), [ptr, lo, hi](size_t start, size_t end) {
+        return count_u8_in_range(ptr + start, end - start, lo, hi);
+    }, std::plus<uint64_t>());
+}
+
+uint64_t count_u8_in_range_parallel(const std::vector<uint8_t>& data, uint8_t lo, uint8_t hi) {
+    return count_u8_in_range_parallel(data.data(), data.size(), lo, hi);
+}
+
+std::array<uint64_t, 256> histogram_u8_parallel(const uint8_t* ptr, size_t len) {
+    using Histogram = std::array<uint64_t, 256>;
+    return parallel_reduce(len, Histogram{}, [ptr](size_t start, size_t end) {
+        Histogram local{};
+        histogram_u8(ptr + start, end - start, local.data());
+        return local;
+    }, [](Histogram total, const Histogram& local) {
+        for (int b = 0; b < 256; ++b) {
+            total[b] += local[b];
+        }
+        return total;
+    });
+}
+
+std::array<uint64_t, 256> histogram_u8_parallel(const std::vector<uint8_t>& data) {
+    return histogram_u8_parallel(data.data(), data.size());
+}
+
+/// Ядра по интерфейсу раскладки: сплошные отрезки (stride 1) идут в SIMD-ядра,
+/// строковые раскладки - скалярным проходом с шагом в 4 независимых аккумулятора
+inline uint64_t sum_u8_strided(const uint8_t* ptr, size_t count, size_t stride) {
+    if (stride == 1) return sum_u8_prefetch_range(ptr, count, DEFAULT_PREFETCH_DISTANCE);
+
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        s0 += ptr[i * stride];
+        s1 += ptr[(i + 1) * stride];
+        s2 += ptr[(i + 2) * stride];
+        s3 += ptr[(i + 3) * stride];
+    }
+    for (; i < count; ++i) {
+        s0 += ptr[i * stride];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+inline uint64_t count_u8_in_range_strided(const uint8_t* ptr, size_t count, size_t stride, uint8_t lo, uint8_t hi) {
+    if (stride == 1) return count_u8_in_range(ptr, count, lo, hi);
+    if (lo > hi) return 0;
+
+    const uint8_t span = hi - lo;
+    uint64_t hits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        hits += static_cast<uint8_t>(ptr[i * stride] - lo) <= span;
+    }
+    return hits;
+}
+
+inline void histogram_u8_strided(const uint8_t* ptr, size_t count, size_t stride, uint64_t* hist) {
+    if (stride == 1) {
+        histogram_u8(ptr, count, hist);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ++hist[ptr[i * stride]];
+    }
+}
+
+template <typename Layout>
+uint64_t sum_ages(const Layout& layout) {
+    return parallel_reduce(layout.size(), uint64_t(0), [&layout](size_t start, size_t end) {
+        uint64_t sum = 0;
+        layout.visit_age_runs(start, end, [&sum](const uint8_t* ages, size_t count, size_t stride) {
+            sum += sum_u8_strided(ages, count, stride);
+        });
+        return sum;
+    }, std::plus<uint64_t>());
+}
+
+template <typename Layout>
+uint64_t count_ages_in_range(const Layout& layout, uint8_t lo, uint8_t hi) {
+    return parallel_reduce(layout.size(), uint64_t(0), [&layout, lo, hi](size_t start, size_t end) {
+        uint64_t hits = 0;
+        layout.visit_age_runs(start, end, [&hits, lo, hi](const uint8_t* ages, size_t count, size_t stride) {
+            hits += count_u8_in_range_strided(ages, count, stride, lo, hi);
+        });
+        return hits;
+    }, std::plus<uint64_t>());
+}
+
+template <typename Layout>
+std::array<uint64_t, 256> age_histogram(const Layout& layout) {
+    using Histogram = std::array<uint64_t, 256>;
+    return parallel_reduce(layout.size(), Histogram{}, [&layout](size_t start, size_t end) {
+        Histogram local{};
+        layout.visit_age_runs(start, end, [&local](const uint8_t* ages, size_t count, size_t stride) {
+            histogram_u8_strided(ages, count, stride, local.data());
+        });
+        return local;
+    }, [](Histogram total, const Histogram& local) {
+        for (int b = 0; b < 256; ++b) {
+            total[b] += local[b];
+        }
+        return total;
+    });
+}
+
+/// Ядра по сегментам: полосы делят между собой сегменты, каждый сегмент - сплошной SIMD-проход
+inline uint64_t sum_u8_chunked(const ChunkedColumn<uint8_t>& column,
+                               size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    return parallel_reduce(column.chunk_count(), uint64_t(0), [&column, prefetch_distance](size_t start, size_t end) {
+        uint64_t sum = 0;
+        for (size_t c = start; c < end; ++c) {
+            sum += sum_u8_prefetch_range(column.chunk_data(c), column.chunk_rows(c), prefetch_distance);
+        }
+        return sum;
+    }, std::plus<uint64_t>());
+}
+
+inline uint64_t count_u8_in_range_chunked(const ChunkedColumn<uint8_t>& column, uint8_t lo, uint8_t hi) {
+    return parallel_reduce(column.chunk_count(), uint64_t(0), [&column, lo, hi](size_t start, size_t end) {
+        uint64_t hits = 0;
+        for (size_t c = start; c < end; ++c) {
+            hits += count_u8_in_range(column.chunk_data(c), column.chunk_rows(c), lo, hi);
+        }
+        return hits;
+    }, std::plus<uint64_t>());
+}
+
+/// Ядра с маской надгробий: удалённые строки выпадают из агрегата прямо в SIMD-цикле.
+/// Слово карты без удалений (обычный случай) идёт тем же путём, что и немаскированный скан.
+#ifdef __AVX2__
+/// 32 бита надгробий → 32 байта: 0xFF там, где строка удалена
+inline __m256i tombstone_byte_mask(uint32_t bits) {
+    const __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(bits)), _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3));
+    const __m256i bit = _mm256_set1_epi64x(static_cast<int64_t>(0x8040201008040201ULL));
+    return _mm256_cmpeq_epi8(_mm256_and_si256(spread, bit), bit);
+}
+#endif
+
+inline uint64_t sum_u8_live(const uint8_t* ptr, size_t len, const std::atomic<uint64_t>* tombstones) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 64 <= len; i += 64) {
+        const uint64_t dead = tombstones[i / 64].load(std::memory_order_relaxed);
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i + 32));
+        if (dead) {
+            lo = _mm256_andnot_si256(tombstone_byte_mask(static_cast<uint32_t>(dead)), lo);
+            hi = _mm256_andnot_si256(tombstone_byte_mask(static_cast<uint32_t>(dead >> 32)), hi);
+        }
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(lo, _mm256_setzero_si256()));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(hi, _mm256_setzero_si256()));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    #endif
+
+    for (; i < len; ++i) {
+        if (!((tombstones[i / 64].load(std::memory_order_relaxed) >> (i % 64)) & 1)) sum += ptr[i];
+    }
+    return sum;
+}
+
+inline uint64_t count_u8_in_range_live(const uint8_t* ptr, size_t len, const std::atomic<uint64_t>* tombstones,
+                                       uint8_t lo, uint8_t hi) {
+    if (lo > hi) return 0;
+
+    uint64_t count = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    const __m256i lo_vec = _mm256_set1_epi8(static_cast<char>(lo));
+    const __m256i span_vec = _mm256_set1_epi8(static_cast<char>(hi - lo));
+    for (; i + 64 <= len; i += 64) {
+        const uint64_t dead = tombstones[i / 64].load(std::memory_order_relaxed);
+        __m256i shifted_lo = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i)), lo_vec);
+        __m256i shifted_hi = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i + 32)), lo_vec);
+        // Бит попадания на строку - надгробия гасятся одной маской на 64 строки
+        const uint64_t hits =
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted_lo, span_vec), shifted_lo))) |
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted_hi, span_vec), shifted_hi)))) << 32;
+        count += std::popcount(hits & ~dead);
+    }
+    #endif
+
+    for (; i < len; ++i) {
+        const bool live = !((tombstones[i / 64].load(std::memory_order_relaxed) >> (i % 64)) & 1);
+        count += live && static_cast<uint8_t>(ptr[i] - lo) <= static_cast<uint8_t>(hi - lo);
+    }
+    return count;
+}
+
+inline uint64_t live_row_count(size_t len, const std::atomic<uint64_t>* tombstones) {
+    uint64_t dead = 0;
+    for (size_t w = 0; w < (len + 63) / 64; ++w) {
+        dead += std::popcount(tombstones[w].load(std::memory_order_relaxed));
+    }
+    return len - dead;
+}
+
+struct LiveAggregate {
+    uint64_t age_sum = 0;
+    uint64_t live_rows = 0;
+};
+
+inline LiveAggregate sum_ages_live(const MutableTableSnapshot& snapshot) {
+    return parallel_reduce(snapshot.chunk_count(), LiveAggregate{}, [&snapshot](size_t start, size_t end) {
+        LiveAggregate local;
+        for (size_t c = start; c < end; ++c) {
+            const MutableChunk& chunk = snapshot.chunk(c);
+            const size_t rows = snapshot.chunk_rows(c);
+            local.age_sum += sum_u8_live(chunk.ages, rows, chunk.tombstones);
+            local.live_rows += live_row_count(rows, chunk.tombstones);
+        }
+        return local;
+    }, [](LiveAggregate total, const LiveAggregate& local) {
+        total.age_sum += local.age_sum;
+        total.live_rows += local.live_rows;
+        return total;
+    });
+}
+
+inline uint64_t count_ages_in_range_live(const MutableTableSnapshot& snapshot, uint8_t lo, uint8_t hi) {
+    return parallel_reduce(snapshot.chunk_count(), uint64_t(0), [&snapshot, lo, hi](size_t start, size_t end) {
+        uint64_t hits = 0;
+        for (size_t c = start; c < end; ++c) {
+            const MutableChunk& chunk = snapshot.chunk(c);
+            hits += count_u8_in_range_live(chunk.ages, snapshot.chunk_rows(c), chunk.tombstones, lo, hi);
+        }
+        return hits;
+    }, std::plus<uint64_t>());
+}
+
+/// Те же 4 подгистограммы, что в histogram_u8; удалённая строка добавляет 0
+inline void histogram_u8_live(const uint8_t* ptr, size_t len, const std::atomic<uint64_t>* tombstones, uint64_t* hist) {
+    constexpr size_t BLOCK = size_t(1) << 30;
+
+    for (size_t block = 0; block < len; block += BLOCK) {
+        const size_t end = std::min(len, block + BLOCK);
+        uint32_t sub[4][256] = {};
+
+        for (size_t i = block; i < end; i += 64) {
+            const uint64_t live = ~tombstones[i / 64].load(std::memory_order_relaxed);
+            const size_t count = std::min<size_t>(64, end - i);
+            size_t j = 0;
+            for (; j + 4 <= count; j += 4) {
+                sub[0][ptr[i + j]] += (live >> j) & 1;
+                sub[1][ptr[i + j + 1]] += (live >> (j + 1)) & 1;
+                sub[2][ptr[i + j + 2]] += (live >> (j + 2)) & 1;
+                sub[3][ptr[i + j + 3]] += (live >> (j + 3)) & 1;
+            }
+            for (; j < count; ++j) {
+                sub[0][ptr[i + j]] += (live >> j) & 1;
+            }
+        }
+
+        for (int b = 0; b < 256; ++b) {
+            hist[b] += uint64_t(sub[0][b]) + sub[1][b] + sub[2][b] + sub[3][b];
+        }
+    }
+}
+
+inline std::array<uint64_t, 256> age_histogram_live(const MutableTableSnapshot& snapshot) {
+    using Histogram = std::array<uint64_t, 256>;
+    return parallel_reduce(snapshot.chunk_count(), Histogram{}, [&snapshot](size_t start, size_t end) {
+        Histogram local{};
+        for (size_t c = start; c < end; ++c) {
+            const MutableChunk& chunk = snapshot.chunk(c);
+            histogram_u8_live(chunk.ages, snapshot.chunk_rows(c), chunk.tombstones, local.data());
+        }
+        return local;
+    }, [](Histogram total, const Histogram& local) {
+        for (int b = 0; b < 256; ++b) {
+            total[b] += local[b];
+        }
+        return total;
+    });
+}
+
+/// TRANSPOSE - пакетное преобразование AoS ↔ SoA, параллельно по строкам 🔀
+/// Фиксированные поля (id, возраст) из AoS вынимаются AVX2-gather'ами с шагом записи,
+/// имена копируются построчно. Обратно id и возраст пишутся скалярно: scatter в AVX2 нет.
+inline void gather_i64_strided(const uint8_t* base, size_t count, size_t stride, int64_t* out) {
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    if (stride <= static_cast<size_t>(INT32_MAX) / 4) {
+        const int32_t s = static_cast<int32_t>(stride);
+        const __m128i offsets = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+        for (; i + 4 <= count; i += 4) {
+            const __m256i ids = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(base + i * stride), offsets, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), ids);
+        }
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        std::memcpy(out + i, base + i * stride, sizeof(int64_t));
+    }
+}
+
+/// Gather берёт 4 байта на строку, поэтому SIMD-цикл не трогает последнюю строку:
+/// лишние 3 байта всегда лежат внутри следующей записи
+inline void gather_u8_strided(const uint8_t* base, size_t count, size_t stride, uint8_t* out) {
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    if (stride >= sizeof(int32_t) && stride <= static_cast<size_t>(INT32_MAX) / 8) {
+        const int32_t s = static_cast<int32_t>(stride);
+        const __m256i offsets = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+        // Младший байт каждого слова - в начало своей 128-битной половины, потом обе половины рядом
+        const __m256i low_bytes = _mm256_setr_epi8(
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256i join_halves = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+        for (; i + 8 < count; i += 8) {
+            const __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base + i * stride), offsets, 1);
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, low_bytes), join_halves);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+        }
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        out[i] = base[i * stride];
+    }
+}
+
+UserSoA users_to_soa(const std::vector<User>& users, const ParallelConfig& config = parallel_config()) {
+    UserSoA soa;
+    soa.resize(users.size());
+    if (users.empty()) return soa;
+
+    const uint8_t* records = reinterpret_cast<const uint8_t*>(users.data());
+    const size_t age_offset = reinterpret_cast<const uint8_t*>(&users[0].age) - records;
+
+    parallel_reduce(users.size(), size_t(0), [&](size_t start, size_t end) {
+        const uint8_t* first = records + start * sizeof(User);
+        gather_i64_strided(first, end - start, sizeof(User), soa.ids.data() + start);
+        gather_u8_strided(first + age_offset, end - start, sizeof(User), soa.ages.data() + start);
+        for (size_t i = start; i < end; ++i) {
+            soa.names[i] = users[i].name;
+        }
+        return end - start;
+    }, std::plus<size_t>(), config);
+    return soa;
+}
+
+std::vector<User> soa_to_users(const UserSoA& soa, const ParallelConfig& config = parallel_config()) {
+    std::vector<User> users(soa.size());
+
+    parallel_reduce(soa.size(), size_t(0), [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i) {
+            User& user = users[i];
+            user.id = soa.ids[i];
+            user.age = soa.ages[i];
+            user.name = soa.names[i];
+        }
+        return end - start;
+    }, std::plus<size_t>(), config);
+    return users;
+}
+
+/// RADIX SCATTER - стабильная параллельная раскладка (ключ, строка) по корзинам 🗂️
+/// Полосы считают свои гистограммы, префиксная сумма даёт каждой полосе её участок
+/// в каждой корзине, затем полосы раскладывают пары через буферы записи - по 8
+/// элементов на корзину, в память уходят целыми строками кэша, а не вразброс по 4 байта.
+/// Общая часть радикс-сортировки и секционирования hash join.
+constexpr size_t RADIX_WC_ENTRIES = 8;
+
+/// key_at(i) -> uint64_t, row_at(i) -> uint32_t, bucket_of(key) -> [0, buckets).
+/// out_keys может быть nullptr. Возвращает начала корзин в выходе (buckets + 1 значение).
+template <typename KeyAt, typename RowAt, typename BucketOf>
+std::vector<uint64_t> scatter_by_bucket(size_t len, size_t buckets, KeyAt&& key_at, RowAt&& row_at, BucketOf&& bucket_of,
+                                        uint64_t* out_keys, uint32_t* out_rows, const ParallelConfig& config) {
+    using Histogram = std::vector<uint64_t>;
+    using LaneHistograms = std::vector<std::pair<size_t, Histogram>>; // (начало полосы, гистограмма)
+
+    // Гистограммы полос в порядке полос - склейка сохраняет порядок
+    LaneHistograms lanes = parallel_reduce(len, LaneHistograms{}, [&](size_t start, size_t end) {
+        LaneHistograms lane;
+        if (start == end) return lane;
+        Histogram hist(buckets, 0);
+        for (size_t i = start; i < end; ++i) {
+            ++hist[bucket_of(key_at(i))];
+        }
+        lane.emplace_back(start, std::move(hist));
+        return lane;
+    }, [](LaneHistograms left, const LaneHistograms& right) {
+        left.insert(left.end(), right.begin(), right.end());
+        return left;
+    }, config);
+
+    // Начало участка полосы в корзине = все меньшие корзины + та же корзина у полос левее
+    std::vector<uint64_t> bucket_starts(buckets + 1);
+    std::vector<Histogram> offsets(lanes.size(), Histogram(buckets));
+    uint64_t running = 0;
+    for (size_t b = 0; b < buckets; ++b) {
+        bucket_starts[b] = running;
+        for (size_t l = 0; l < lanes.size(); ++l) {
+            offsets[l][b] = running;
+            running += lanes[l].second[b];
+        }
+    }
+    bucket_starts[buckets] = running;
+
+    parallel_reduce(len, size_t(0), [&](size_t start, size_t end) {
+        if (start == end) return size_t(0);
+        const size_t lane = std::lower_bound(lanes.begin(), lanes.end(), start,
+                                             [](const auto& entry, size_t value) { return entry.first < value; }) - lanes.begin();
+        Histogram& cursor = offsets[lane];
+
+        struct alignas(64) WriteBuffer {
+            uint64_t keys[RADIX_WC_ENTRIES];
+            uint32_t rows[RADIX_WC_ENTRIES];
+            uint32_t fill;
+        };
+        std::vector<WriteBuffer> write_buffers(buckets);
+        for (auto& buffer : write_buffers) buffer.fill = 0;
+
+        for (size_t i = start; i < end; ++i) {
+            const uint64_t key = key_at(i);
+            const size_t bucket = bucket_of(key);
+            WriteBuffer& buffer = write_buffers[bucket];
+            buffer.keys[buffer.fill] = key;
+            buffer.rows[buffer.fill] = row_at(i);
+            if (++buffer.fill == RADIX_WC_ENTRIES) {
+                // Полный буфер - копия фиксированной длины, разворачивается в пару векторных store
+                if (out_keys) std::memcpy(out_keys + cursor[bucket], buffer.keys, sizeof(buffer.keys));
+                std::memcpy(out_rows + cursor[bucket], buffer.rows, sizeof(buffer.rows));
+                cursor[bucket] += RADIX_WC_ENTRIES;
+                buffer.fill = 0;
+            }
+        }
+        for (size_t bucket = 0; bucket < buckets; ++bucket) {
+            const WriteBuffer& buffer = write_buffers[bucket];
+            if (out_keys) std::memcpy(out_keys + cursor[bucket], buffer.keys, buffer.fill * sizeof(uint64_t));
+            std::memcpy(out_rows + cursor[bucket], buffer.rows, buffer.fill * sizeof(uint32_t));
+        }
+        return end - start;
+    }, std::plus<size_t>(), config);
+
+    return bucket_starts;
+}
+
+/// RADIX SORT - параллельная LSD-сортировка колонки в перестановку строк 🔢⚡
+/// Байт за проход через scatter_by_bucket. Проход, где все ключи в одной корзине,
+/// пропускается (id 0..100M - 4 прохода из 8). Перестановка стабильна; строки адресуются uint32_t.
+constexpr size_t RADIX_BUCKETS = 256;
+
+enum class UserColumn {
+    Id,
+    Age
+};
+
+/// Ключ в беззнаковом порядке: знаковым инвертируем старший бит
+template <typename Key>
+inline uint64_t radix_key(Key key) {
+    if constexpr (std::is_signed_v<Key>) {
+        return static_cast<uint64_t>(static_cast<std::make_unsigned_t<Key>>(key)) ^ (uint64_t(1) << (sizeof(Key) * 8 - 1));
+    } else {
+        return static_cast<uint64_t>(key);
+    }
+}
+
+template <typename Key>
+std::vector<uint32_t> radix_sort_permutation(const Key* column, size_t len, const ParallelConfig& config = parallel_config()) {
+    if (len > UINT32_MAX) throw std::length_error("radix_sort_permutation: more than 2^32 rows");
+
+    using Histogram = std::array<uint64_t, RADIX_BUCKETS>;
+    constexpr size_t DIGITS = sizeof(Key);
+
+    // Один проход по колонке: какие байты вообще различаются - остальные проходы не нужны
+    using DigitHistograms = std::array<Histogram, DIGITS>;
+    const DigitHistograms totals = parallel_reduce(len, DigitHistograms{}, [column](size_t start, size_t end) {
+        DigitHistograms local{};
+        for (size_t i = start; i < end; ++i) {
+            const uint64_t key = radix_key(column[i]);
+            for (size_t d = 0; d < DIGITS; ++d) ++local[d][(key >> (d * 8)) & 0xFF];
+        }
+        return local;
+    }, [](DigitHistograms total, const DigitHistograms& local) {
+        for (size_t d = 0; d < DIGITS; ++d) {
+            for (size_t b = 0; b < RADIX_BUCKETS; ++b) total[d][b] += local[d][b];
+        }
+        return total;
+    }, config);
+
+    std::vector<size_t> passes;
+    for (size_t d = 0; d < DIGITS; ++d) {
+        if (std::none_of(totals[d].begin(), totals[d].end(), [len](uint64_t count) { return count == len; })) passes.push_back(d);
+    }
+
+    std::vector<uint32_t> rows, next_rows(len);
+    if (passes.empty()) {
+        for (size_t i = 0; i < len; ++i) next_rows[i] = static_cast<uint32_t>(i); // все ключи равны
+        return next_rows;
+    }
+
+    // Ключи и второй буфер строк нужны между проходами; однопроходная сортировка (возраст) обходится без них
+    const bool carry_keys = passes.size() > 1;
+    if (carry_keys) rows.resize(len);
+    auto keys = std::make_unique_for_overwrite<uint64_t[]>(carry_keys ? len : 0);
+    auto next_keys = std::make_unique_for_overwrite<uint64_t[]>(carry_keys ? len : 0);
+
+    for (size_t p = 0; p < passes.size(); ++p) {
+        const size_t shift = passes[p] * 8;
+        uint64_t* out_keys = p + 1 < passes.size() ? next_keys.get() : nullptr;
+        auto digit = [shift](uint64_t key) { return static_cast<size_t>((key >> shift) & 0xFF); };
+
+        if (p == 0) {
+            scatter_by_bucket(len, RADIX_BUCKETS, [column](size_t i) { return radix_key(column[i]); },
+                              [](size_t i) { return static_cast<uint32_t>(i); }, digit, out_keys, next_rows.data(), config);
+        } else {
+            const uint64_t* in_keys = keys.get();
+            const uint32_t* in_rows = rows.data();
+            scatter_by_bucket(len, RADIX_BUCKETS, [in_keys](size_t i) { return in_keys[i]; },
+                              [in_rows](size_t i) { return in_rows[i]; }, digit, out_keys, next_rows.data(), config);
+        }
+
+        std::swap(keys, next_keys);
+        rows.swap(next_rows);
+    }
+    return rows;
+}
+
+/// Возраст - один проход (сортировка подсчётом), id - до 8 проходов
+inline std::vector<uint32_t> sort_permutation(const UserSoA& soa, UserColumn column,
+                                              const ParallelConfig& config = parallel_config()) {
+    if (column == UserColumn::Age) return radix_sort_permutation(soa.ages.data(), soa.size(), config);
+    return radix_sort_permutation(soa.ids.data(), soa.size(), config);
+}
+
+/// Новое хранилище: строка i = строка permutation[i] исходного
+inline UserSoA permute_users(const UserSoA& soa, const std::vector<uint32_t>& permutation,
+                             const ParallelConfig& config = parallel_config()) {
+    UserSoA sorted;
+    sorted.resize(permutation.size());
+    parallel_reduce(permutation.size(), size_t(0), [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i) {
+            const uint32_t row = permutation[i];
+            sorted.ids[i] = soa.ids[row];
+            sorted.ages[i] = soa.ages[row];
+            sorted.names[i] = soa.names[row];
+        }
+        return end - start;
+    }, std::plus<size_t>(), config);
+    return sorted;
+}
+
+/// На месте: колонки переставляются по одной, в пике - одна лишняя колонка; имена переносятся
+template <typename T>
+inline void permute_column(std::vector<T>& column, const std::vector<uint32_t>& permutation, const ParallelConfig& config) {
+    std::vector<T> reordered(column.size());
+    parallel_reduce(permutation.size(), size_t(0), [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i) {
+            reordered[i] = std::move(column[permutation[i]]);
+        }
+        return end - start;
+    }, std::plus<size_t>(), config);
+    column.swap(reordered);
+}
+
+inline void permute_users_in_place(UserSoA& soa, const std::vector<uint32_t>& permutation,
+                                   const ParallelConfig& config = parallel_config()) {
+    permute_column(soa.ids, permutation, config);
+    permute_column(soa.ages, permutation, config);
+    permute_column(soa.names, permutation, config);
+}
+
+inline void sort_users(UserSoA& soa, UserColumn column, const ParallelConfig& config = parallel_config()) {
+    permute_users_in_place(soa, sort_permutation(soa, column, config), config);
+}
+
+/// TOP-K - K лучших строк по колонке: SIMD-порог + буфер кандидатов на полосу 🏆⚡
+/// Блок из 32 (u8) или 16 (i64) строк сравнивается с порогом - ключом K-го кандидата -
+/// одной маской, в буфер попадают только строки строго лучше. Переполненный буфер
+/// ужимается nth_element до K, и порог подтягивается. В отличие от кучи, даже
+/// отсортированная колонка (каждая строка - кандидат) стоит O(1) на строку.
+/// При равных ключах выигрывает меньшая строка. Полосы сливаются в конце,
+/// имена читаются только для итоговых K строк.
+constexpr size_t TOP_K_BUFFER = 4096;
+
+enum class TopKOrder {
+    Largest,
+    Smallest
+};
+
+template <typename Key>
+struct TopKEntry {
+    Key key;
+    size_t row;
+};
+
+/// a лучше b: ключ больше (меньше для Smallest), при равенстве - раньше в колонке
+template <typename Key>
+inline bool top_k_better(const TopKEntry<Key>& a, const TopKEntry<Key>& b, TopKOrder order) {
+    if (a.key != b.key) return order == TopKOrder::Largest ? a.key > b.key : a.key < b.key;
+    return a.row < b.row;
+}
+
+/// Бит i - строка i блока строго лучше порога
+inline uint32_t top_k_block_mask(const uint8_t* ptr, uint8_t threshold, TopKOrder order) {
+    #ifdef __AVX2__
+    // x > t  <=>  max(x, t + 1) == x;  x < t  <=>  min(x, t - 1) == x (t на краю отсекается раньше)
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    const __m256i hits = order == TopKOrder::Largest
+        ? _mm256_cmpeq_epi8(_mm256_max_epu8(values, _mm256_set1_epi8(static_cast<char>(threshold + 1))), values)
+        : _mm256_cmpeq_epi8(_mm256_min_epu8(values, _mm256_set1_epi8(static_cast<char>(threshold - 1))), values);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+    #else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < 32; ++i) {
+        mask |= uint32_t(order == TopKOrder::Largest ? ptr[i] > threshold : ptr[i] < threshold) << i;
+    }
+    return mask;
+    #endif
+}
+
+inline uint32_t top_k_block_mask(const int64_t* ptr, int64_t threshold, TopKOrder order) {
+    #ifdef __AVX2__
+    const __m256i limit = _mm256_set1_epi64x(threshold);
+    uint32_t mask = 0;
+    for (int v = 0; v < 4; ++v) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + v * 4));
+        const __m256i hits = order == TopKOrder::Largest ? _mm256_cmpgt_epi64(values, limit) : _mm256_cmpgt_epi64(limit, values);
+        mask |= static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(hits))) << (v * 4);
+    }
+    return mask;
+    #else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < 16; ++i) {
+        mask |= uint32_t(order == TopKOrder::Largest ? ptr[i] > threshold : ptr[i] < threshold) << i;
+    }
+    return mask;
+    #endif
+}
+
+/// Ключи на краю диапазона не может превзойти ничто - блоки дальше не смотрим
+template <typename Key>
+inline bool top_k_threshold_final(Key threshold, TopKOrder order) {
+    return order == TopKOrder::Largest ? threshold == std::numeric_limits<Key>::max()
+                                       : threshold == std::numeric_limits<Key>::min();
+}
+
+/// Итог отсортирован от лучшего к худшему
+template <typename Key>
+std::vector<TopKEntry<Key>> top_k(const Key* column, size_t len, size_t k, TopKOrder order,
+                                  const ParallelConfig& config = parallel_config()) {
+    using Entries = std::vector<TopKEntry<Key>>;
+    constexpr size_t BLOCK = sizeof(Key) == 1 ? 32 : 16;
+    if (k == 0) return {};
+
+    auto better = [order](const TopKEntry<Key>& a, const TopKEntry<Key>& b) { return top_k_better(a, b, order); };
+
+    Entries merged = parallel_reduce(len, Entries{}, [&](size_t start, size_t end) {
+        Entries candidates;
+        candidates.reserve(k + TOP_K_BUFFER);
+        bool full = false;
+        Key threshold{};
+
+        // Оставляет K лучших; candidates[k - 1] - худший из них, он и есть новый порог
+        auto tighten = [&] {
+            if (candidates.size() < k) return;
+            std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end(), better);
+            candidates.resize(k);
+            threshold = candidates[k - 1].key;
+            full = true;
+        };
+
+        size_t i = start;
+        for (; i + BLOCK <= end; i += BLOCK) {
+            if (!full) {
+                for (size_t j = i; j < i + BLOCK; ++j) candidates.push_back(TopKEntry<Key>{column[j], j});
+            } else {
+                if (top_k_threshold_final(threshold, order)) break;
+                for (uint32_t mask = top_k_block_mask(column + i, threshold, order); mask; mask &= mask - 1) {
+                    const size_t row = i + std::countr_zero(mask);
+                    candidates.push_back(TopKEntry<Key>{column[row], row});
+                }
+            }
+            if (candidates.size() >= k + TOP_K_BUFFER - BLOCK) tighten();
+        }
+        if (!full || !top_k_threshold_final(threshold, order)) {
+            for (; i < end; ++i) candidates.push_back(TopKEntry<Key>{column[i], i});
+        }
+        tighten();
+        return candidates;
+    }, [&](Entries left, const Entries& right) {
+        left.insert(left.end(), right.begin(), right.end());
+        if (left.size() > k) {
+            std::nth_element(left.begin(), left.begin() + k, left.end(), better);
+            left.resize(k);
+        }
+        return left;
+    }, config);
+
+    std::sort(merged.begin(), merged.end(), better);
+    return merged;
+}
+
+struct TopKUser {
+    size_t row;
+    int64_t id;
+    uint8_t age;
+    std::string name;
+};
+
+/// K самых старых/молодых (Age) или с наибольшими/наименьшими id (Id), с именами
+inline std::vector<TopKUser> top_k_users(const UserSoA& soa, UserColumn column, size_t k, TopKOrder order,
+                                         const ParallelConfig& config = parallel_config()) {
+    std::vector<size_t> rows;
+    if (column == UserColumn::Age) {
+        for (const auto& entry : top_k(soa.ages.data(), soa.size(), k, order, config)) rows.push_back(entry.row);
+    } else {
+        for (const auto& entry : top_k(soa.ids.data(), soa.size(), k, order, config)) rows.push_back(entry.row);
+    }
+
+    std::vector<TopKUser> users;
+    users.reserve(rows.size());
+    for (size_t row : rows) {
+        users.push_back(TopKUser{row, soa.ids[row], soa.ages[row], soa.names[row]});
+    }
+    return users;
+}
+
+/// HASH JOIN - радикс-секционированная сборка + пакетный probe с предвыборкой 🔗⚡
+/// Меньшая сторона раскладывается scatter_by_bucket на 2^bits секций по старшим битам
+/// хэша - по ~8K строк, чтобы таблица секции (~256KB) строилась в L2. Больше 2^8 секций
+/// раскладывается в два прохода (грубые секции, затем каждая отдельно): веер одного
+/// прохода не больше 256 буферов записи и не бьёт по TLB. Секции строятся параллельно,
+/// каждая в своём отрезке общего массива корзин. Корзина - кэш-линия с 4 ключами,
+/// probe сравнивает их одним AVX2 cmpeq. Большая сторона не секционируется: probe идёт
+/// пачками по 16 ключей - сначала хэши и предвыборка корзин, потом сравнения, так что
+/// промахи кэша перекрываются. Результат - пары номеров строк (поздняя материализация).
+constexpr size_t JOIN_BUCKET_KEYS = 4;
+constexpr size_t JOIN_PARTITION_ROWS = 8 * 1024; // 4K корзин по 64B - секция в L2
+constexpr size_t JOIN_PASS_BITS = 8;          // веер одного прохода раскладки
+constexpr size_t JOIN_MAX_PARTITION_BITS = 16; // два прохода: ~256KB на секцию до 512M строк
+constexpr size_t JOIN_PROBE_BATCH = 16;
+
+struct alignas(64) JoinBucket {
+    int64_t keys[JOIN_BUCKET_KEYS];
+    uint32_t rows[JOIN_BUCKET_KEYS];
+    uint32_t count;
+};
+
+/// Финализатор MurmurHash3: старшие биты - секция, младшие - корзина в секции
+inline uint64_t join_hash(int64_t key) {
+    uint64_t h = static_cast<uint64_t>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+class JoinHashTable {
+private:
+    size_t partition_bits = 0;
+    std::vector<uint64_t> partition_first; // первая корзина секции
+    std::vector<uint64_t> partition_mask;  // число корзин секции - 1 (степень двойки)
+    std::unique_ptr<JoinBucket[]> buckets;
+
+    size_t partition_of(uint64_t hash) const { return partition_bits ? hash >> (64 - partition_bits) : 0; }
+
+public:
+    JoinHashTable(const int64_t* keys, size_t len, const ParallelConfig& config = parallel_config()) {
+        while (partition_bits < JOIN_MAX_PARTITION_BITS && (len >> partition_bits) > JOIN_PARTITION_ROWS) ++partition_bits;
+        const size_t partitions = size_t(1) << partition_bits;
+
+        // Первый проход - по старшим coarse_bits битам; при одном проходе это и есть секции
+        const size_t coarse_bits = partition_bits > JOIN_PASS_BITS ? (partition_bits + 1) / 2 : partition_bits;
+        const size_t fine_bits = partition_bits - coarse_bits;
+        auto part_keys = std::make_unique_for_overwrite<uint64_t[]>(len);
+        auto part_rows = std::make_unique_for_overwrite<uint32_t[]>(len);
+        std::vector<uint64_t> starts = scatter_by_bucket(len, size_t(1) << coarse_bits,
+            [keys](size_t i) { return static_cast<uint64_t>(keys[i]); },
+            [](size_t i) { return static_cast<uint32_t>(i); },
+            [this, fine_bits](uint64_t key) { return partition_of(join_hash(static_cast<int64_t>(key))) >> fine_bits; },
+            part_keys.get(), part_rows.get(), config);
+
+        // Второй проход: грубые секции параллельно, каждая раскладывается одной полосой
+        // на 2^fine_bits секций в тот же отрезок второго буфера. Раскладка стабильна -
+        // итог совпадает с одним проходом по partition_bits битам.
+        if (fine_bits > 0) {
+            const size_t coarse = size_t(1) << coarse_bits;
+            const size_t fine = size_t(1) << fine_bits;
+            auto fine_keys = std::make_unique_for_overwrite<uint64_t[]>(len);
+            auto fine_rows = std::make_unique_for_overwrite<uint32_t[]>(len);
+            std::vector<uint64_t> fine_starts(partitions + 1);
+            const ParallelConfig lane_config{config.backend, 1};
+
+            parallel_reduce(coarse, size_t(0), [&](size_t first, size_t last) {
+                for (size_t q = first; q < last; ++q) {
+                    const uint64_t begin = starts[q];
+                    const std::vector<uint64_t> sub = scatter_by_bucket(starts[q + 1] - begin, fine,
+                        [&](size_t i) { return part_keys[begin + i]; },
+                        [&](size_t i) { return part_rows[begin + i]; },
+                        [this, fine](uint64_t key) { return partition_of(join_hash(static_cast<int64_t>(key))) & (fine - 1); },
+                        fine_keys.get() + begin, fine_rows.get() + begin, lane_config);
+                    for (size_t f = 0; f < fine; ++f) fine_starts[q * fine + f] = begin + sub[f];
+                }
+                return last - first;
+            }, std::plus<size_t>(), config);
+
+            fine_starts[partitions] = len;
+            starts = std::move(fine_starts);
+            part_keys = std::move(fine_keys);
+            part_rows = std::move(fine_rows);
+        }
+
+        // Корзин вдвое меньше строк секции - заполнено не больше половины мест: полная
+        // корзина заставляет probe читать и следующую, плотнее выходит медленнее
+        partition_first.resize(partitions + 1);
+        partition_mask.resize(partitions);
+        uint64_t total = 0;
+        for (size_t p = 0; p < partitions; ++p) {
+            const uint64_t capacity = std::bit_ceil(std::max<uint64_t>(1, (starts[p + 1] - starts[p] + 1) / 2));
+            partition_first[p] = total;
+            partition_mask[p] = capacity - 1;
+            total += capacity;
+        }
+        partition_first[partitions] = total;
+        buckets = std::make_unique_for_overwrite<JoinBucket[]>(total);
+
+        // Секции строятся параллельно; порядок вставки = порядок строк, дубликаты идут по возрастанию
+        parallel_reduce(partitions, size_t(0), [&](size_t first, size_t last) {
+            for (size_t p = first; p < last; ++p) {
+                JoinBucket* table = buckets.get() + partition_first[p];
+                // Пустые места тоже обнуляются: probe сравнивает все 4 ключа корзины и маскирует по count
+                for (uint64_t b = 0; b <= partition_mask[p]; ++b) table[b] = JoinBucket{};
+
+                for (uint64_t i = starts[p]; i < starts[p + 1]; ++i) {
+                    const int64_t key = static_cast<int64_t>(part_keys[i]);
+                    uint64_t b = join_hash(key) & partition_mask[p];
+                    while (table[b].count == JOIN_BUCKET_KEYS) b = (b + 1) & partition_mask[p];
+                    JoinBucket& bucket = table[b];
+                    bucket.keys[bucket.count] = key;
+                    bucket.rows[bucket.count] = part_rows[i];
+                    ++bucket.count;
+                }
+            }
+            return last - first;
+        }, std::plus<size_t>(), config);
+    }
+
+    const JoinBucket* home_bucket(uint64_t hash) const {
+        const size_t p = partition_of(hash);
+        return buckets.get() + partition_first[p] + (hash & partition_mask[p]);
+    }
+
+    /// emit(build_row) для каждой строки с этим ключом; цепочка кончается на неполной корзине
+    template <typename Emit>
+    void probe(int64_t key, uint64_t hash, Emit&& emit) const {
+        const size_t p = partition_of(hash);
+        const JoinBucket* table = buckets.get() + partition_first[p];
+        for (uint64_t b = hash & partition_mask[p];; b = (b + 1) & partition_mask[p]) {
+            const JoinBucket& bucket = table[b];
+            uint32_t matches;
+            #ifdef __AVX2__
+            const __m256i hits = _mm256_cmpeq_epi64(_mm256_load_si256(reinterpret_cast<const __m256i*>(bucket.keys)),
+                                                    _mm256_set1_epi64x(key));
+            matches = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(hits)));
+            #else
+            matches = 0;
+            for (size_t k = 0; k < JOIN_BUCKET_KEYS; ++k) matches |= uint32_t(bucket.keys[k] == key) << k;
+            #endif
+            for (matches &= (1u << bucket.count) - 1; matches; matches &= matches - 1) {
+                emit(bucket.rows[std::countr_zero(matches)]);
+            }
+            if (bucket.count < JOIN_BUCKET_KEYS) return;
+        }
+    }
+};
+
+struct JoinResult {
+    std::vector<uint32_t> left_rows;
+    std::vector<uint32_t> right_rows;
+
+    size_t size() const { return left_rows.size(); }
+};
+
+/// Эквисоединение left_keys = right_keys; таблица строится по меньшей стороне
+inline JoinResult hash_join(const int64_t* left_keys, size_t left_len, const int64_t* right_keys, size_t right_len,
+                            const ParallelConfig& config = parallel_config()) {
+    if (left_len > UINT32_MAX || right_len > UINT32_MAX) throw std::length_error("hash_join: more than 2^32 rows");
+
+    const bool build_left = left_len <= right_len;
+    const int64_t* build_keys = build_left ? left_keys : right_keys;
+    const int64_t* probe_keys = build_left ? right_keys : left_keys;
+    const size_t build_len = build_left ? left_len : right_len;
+    const size_t probe_len = build_left ? right_len : left_len;
+
+    const JoinHashTable table(build_keys, build_len, config);
+
+    // Куски полос: left_rows - строки стороны сборки, right_rows - стороны probe
+    using Pieces = std::vector<std::shared_ptr<JoinResult>>;
+    Pieces pieces = parallel_reduce(probe_len, Pieces{}, [&](size_t start, size_t end) {
+        if (start == end) return Pieces{};
+        auto piece = std::make_shared<JoinResult>();
+        piece->left_rows.reserve(end - start); // обычно не больше пары на строку probe
+        piece->right_rows.reserve(end - start);
+        uint64_t hashes[JOIN_PROBE_BATCH];
+
+        for (size_t i = start; i < end; i += JOIN_PROBE_BATCH) {
+            const size_t batch = std::min(JOIN_PROBE_BATCH, end - i);
+            for (size_t j = 0; j < batch; ++j) {
+                hashes[j] = join_hash(probe_keys[i + j]);
+                _mm_prefetch(reinterpret_cast<const char*>(table.home_bucket(hashes[j])), _MM_HINT_T0);
+            }
+            for (size_t j = 0; j < batch; ++j) {
+                const uint32_t probe_row = static_cast<uint32_t>(i + j);
+                table.probe(probe_keys[i + j], hashes[j], [&](uint32_t build_row) {
+                    piece->left_rows.push_back(build_row);
+                    piece->right_rows.push_back(probe_row);
+                });
+            }
+        }
+        return Pieces{piece};
+    }, [](Pieces left, const Pieces& right) {
+        left.insert(left.end(), right.begin(), right.end());
+        return left;
+    }, config);
+
+    // Склейка кусков по порядку полос - пары упорядочены по строке probe
+    JoinResult result;
+    if (pieces.size() == 1) {
+        result = std::move(*pieces.front());
+        if (!build_left) result.left_rows.swap(result.right_rows);
+        return result;
+    }
+
+    std::vector<size_t> piece_offsets(pieces.size() + 1, 0);
+    for (size_t k = 0; k < pieces.size(); ++k) piece_offsets[k + 1] = piece_offsets[k] + pieces[k]->size();
+
+    result.left_rows.resize(piece_offsets.back());
+    result.right_rows.resize(piece_offsets.back());
+    parallel_reduce(pieces.size(), size_t(0), [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            std::copy(pieces[k]->left_rows.begin(), pieces[k]->left_rows.end(), result.left_rows.begin() + piece_offsets[k]);
+            std::copy(pieces[k]->right_rows.begin(), pieces[k]->right_rows.end(), result.right_rows.begin() + piece_offsets[k]);
+        }
+        return last - first;
+    }, std::plus<size_t>(), config);
+
+    if (!build_left) result.left_rows.swap(result.right_rows);
+    return result;
+}
+
+/// PACKED IDS - id-колонка блоками по 256 строк: frame-of-reference + битовая упаковка 🗜️
+/// Блок хранит минимум (base) и смещения id - base по bits бит. Неубывающий блок может
+/// храниться дельтами: шаг id[i] - id[i-1] минус минимальный шаг delta, тоже по bits бит;
+/// у сплошных id (шаг 1) bits = 0 и от блока остаётся один заголовок. Кодировщик берёт
+/// вариант с меньшим bits; блок с размахом >= 2^32 остаётся сырым int64.
+/// Раскладка вертикальная: 8 полос по 32 строки, слово k полосы l лежит в words[8k + l],
+/// строка 8d + l - в полосе l на глубине d. Один AVX2-регистр распаковывает 8 соседних
+/// строк сдвигами на константы, и фильтр/агрегат получают смещения прямо в регистрах.
+/// Размах блока (span) - карта зон: блок целиком вне или внутри диапазона не распаковывается.
+constexpr size_t ID_BLOCK_ROWS = 256;
+constexpr size_t ID_BLOCK_LANES = 8;
+constexpr size_t ID_BLOCK_DEPTH = ID_BLOCK_ROWS / ID_BLOCK_LANES;
+
+enum class IdEncoding : uint8_t { FrameOfReference, Delta, Raw };
+
+struct IdBlock {
+    int64_t base = 0;   // минимум блока (у Delta это и первый id)
+    uint32_t span = 0;  // максимум - base
+    uint32_t delta = 0; // минимальный шаг (Delta)
+    uint32_t offset = 0; // первое слово в words (Raw - первое значение в raw_values)
+    uint8_t bits = 0;
+    IdEncoding encoding = IdEncoding::FrameOfReference;
+};
+
+/// Упакованное значение строки slot блока (скалярно)
+inline uint32_t packed_id_value(const uint32_t* words, unsigned bits, size_t slot) {
+    if (bits == 0) return 0;
+    const size_t lane = slot % ID_BLOCK_LANES;
+    const size_t bit = (slot / ID_BLOCK_LANES) * bits;
+    const size_t shift = bit % 32;
+    uint64_t value = words[(bit / 32) * ID_BLOCK_LANES + lane] >> shift;
+    if (shift + bits > 32) value |= static_cast<uint64_t>(words[(bit / 32 + 1) * ID_BLOCK_LANES + lane]) << (32 - shift);
+    return static_cast<uint32_t>(value & ((uint64_t(1) << bits) - 1));
+}
+
+class PackedIdColumn {
+private:
+    std::vector<IdBlock> blocks;
+    std::vector<uint32_t> words;
+    std::vector<int64_t> raw_values;
+    size_t rows = 0;
+
+    static IdBlock plan_block(const int64_t* ids, size_t count) {
+        int64_t lo = ids[0], hi = ids[0];
+        bool ascending = true;
+        uint64_t min_step = std::numeric_limits<uint64_t>::max(), max_step = 0;
+        for (size_t i = 1; i < count; ++i) {
+            lo = std::min(lo, ids[i]);
+            hi = std::max(hi, ids[i]);
+            if (ids[i] < ids[i - 1]) {
+                ascending = false;
+                continue;
+            }
+            const uint64_t step = static_cast<uint64_t>(ids[i]) - static_cast<uint64_t>(ids[i - 1]);
+            min_step = std::min(min_step, step);
+            max_step = std::max(max_step, step);
+        }
+
+        IdBlock block;
+        block.base = lo;
+        const uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+        if (span > UINT32_MAX) {
+            block.encoding = IdEncoding::Raw;
+            return block;
+        }
+        block.span = static_cast<uint32_t>(span);
+        block.bits = static_cast<uint8_t>(std::bit_width(span));
+        if (ascending && count > 1 && std::bit_width(max_step - min_step) < block.bits) {
+            block.encoding = IdEncoding::Delta;
+            block.delta = static_cast<uint32_t>(min_step);
+            block.bits = static_cast<uint8_t>(std::bit_width(max_step - min_step));
+        }
+        return block;
+    }
+
+    static void pack_block(const IdBlock& block, const int64_t* ids, size_t count, uint32_t* out) {
+        if (block.bits == 0) return; // слов у блока нет
+        for (size_t slot = 0; slot < count; ++slot) {
+            uint64_t value = static_cast<uint64_t>(ids[slot]) - static_cast<uint64_t>(block.base);
+            if (block.encoding == IdEncoding::Delta) {
+                value = slot ? static_cast<uint64_t>(ids[slot]) - static_cast<uint64_t>(ids[slot - 1]) - block.delta : 0;
+            }
+            const size_t lane = slot % ID_BLOCK_LANES;
+            const size_t bit = (slot / ID_BLOCK_LANES) * block.bits;
+            const size_t shift = bit % 32;
+            out[(bit / 32) * ID_BLOCK_LANES + lane] |= static_cast<uint32_t>(value << shift);
+            if (shift + block.bits > 32) out[(bit / 32 + 1) * ID_BLOCK_LANES + lane] |= static_cast<uint32_t>(value >> (32 - shift));
+        }
+    }
+
+public:
+    /// Два параллельных прохода по блокам: план (кодировка и ширина), затем упаковка
+    static PackedIdColumn encode(const int64_t* ids, size_t len, const ParallelConfig& config = parallel_config()) {
+        if (len > UINT32_MAX) throw std::length_error("PackedIdColumn: more than 2^32 rows");
+
+        PackedIdColumn column;
+        column.rows = len;
+        column.blocks.resize((len + ID_BLOCK_ROWS - 1) / ID_BLOCK_ROWS);
+
+        parallel_reduce(column.blocks.size(), size_t(0), [&](size_t start, size_t end) {
+            for (size_t b = start; b < end; ++b) column.blocks[b] = plan_block(ids + b * ID_BLOCK_ROWS, column.block_rows(b));
+            return end - start;
+        }, std::plus<size_t>(), config);
+
+        size_t word_count = 0, raw_count = 0;
+        for (IdBlock& block : column.blocks) {
+            if (block.encoding == IdEncoding::Raw) {
+                block.offset = static_cast<uint32_t>(raw_count);
+                raw_count += ID_BLOCK_ROWS;
+            } else {
+                block.offset = static_cast<uint32_t>(word_count);
+                word_count += block.bits * ID_BLOCK_LANES;
+            }
+        }
+        column.words.resize(word_count);
+        column.raw_values.resize(raw_count);
+
+        parallel_reduce(column.blocks.size(), size_t(0), [&](size_t start, size_t end) {
+            for (size_t b = start; b < end; ++b) {
+                const IdBlock& block = column.blocks[b];
+                const int64_t* source = ids + b * ID_BLOCK_ROWS;
+                if (block.encoding == IdEncoding::Raw) {
+                    std::copy(source, source + column.block_rows(b), column.raw_values.begin() + block.offset);
+                } else {
+                    pack_block(block, source, column.block_rows(b), column.words.data() + block.offset);
+                }
+            }
+            return end - start;
+        }, std::plus<size_t>(), config);
+        return column;
+    }
+
+    size_t size() const { return rows; }
+    size_t block_count() const { return blocks.size(); }
+    const IdBlock& block(size_t b) const { return blocks[b]; }
+    size_t block_rows(size_t b) const { return b + 1 < blocks.size() ? ID_BLOCK_ROWS : rows - b * ID_BLOCK_ROWS; }
+    const uint32_t* block_words(size_t b) const { return words.data() + blocks[b].offset; }
+    const int64_t* block_raw(size_t b) const { return raw_values.data() + blocks[b].offset; }
+
+    /// Произвольный доступ; у Delta-блока - проход по шагам от начала блока
+    int64_t operator[](size_t row) const {
+        const IdBlock& block = blocks[row / ID_BLOCK_ROWS];
+        const size_t slot = row % ID_BLOCK_ROWS;
+        if (block.encoding == IdEncoding::Raw) return raw_values[block.offset + slot];
+
+        const uint32_t* packed = words.data() + block.offset;
+        uint64_t offset = 0;
+        if (block.encoding == IdEncoding::Delta) {
+            offset = uint64_t(block.delta) * slot;
+            for (size_t i = 1; i <= slot; ++i) offset += packed_id_value(packed, block.bits, i);
+        } else {
+            offset = packed_id_value(packed, block.bits, slot);
+        }
+        return static_cast<int64_t>(static_cast<uint64_t>(block.base) + offset);
+    }
+
+    size_t compressed_bytes() const {
+        return blocks.size() * sizeof(IdBlock) + words.size() * sizeof(uint32_t) + raw_values.size() * sizeof(int64_t);
+    }
+};
+
+#ifdef __AVX2__
+/// Распаковка блока шириной Bits: sink(offsets, d) для d = 0..31, offsets - строки 8d..8d+7.
+/// Сдвиги зависят только от d и Bits - после раскрутки цикла это константы
+template <unsigned Bits, typename Sink>
+void unpack_id_block(const uint32_t* words, Sink& sink) {
+    for (unsigned d = 0; d < ID_BLOCK_DEPTH; ++d) {
+        if constexpr (Bits == 0) {
+            sink(_mm256_setzero_si256(), d);
+        } else {
+            const unsigned bit = d * Bits;
+            const unsigned shift = bit % 32;
+            const uint32_t* word = words + (bit / 32) * ID_BLOCK_LANES;
+            __m256i value = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(word)), shift);
+            if (shift + Bits > 32) {
+                const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(word + ID_BLOCK_LANES));
+                value = _mm256_or_si256(value, _mm256_slli_epi32(next, 32 - shift));
+            }
+            if constexpr (Bits < 32) value = _mm256_and_si256(value, _mm256_set1_epi32(static_cast<int>((1u << Bits) - 1)));
+            sink(value, d);
+        }
+    }
+}
+
+/// Таблица из 33 специализаций по ширине - один косвенный вызов на блок
+template <typename Sink, size_t... Bits>
+void unpack_id_block_dispatch(unsigned bits, const uint32_t* words, Sink& sink, std::index_sequence<Bits...>) {
+    static constexpr void (*table[])(const uint32_t*, Sink&) = {&unpack_id_block<Bits, Sink>...};
+    table[bits](words, sink);
+}
+
+/// Смещения id - base для 8 строк за раз: FOR - распакованное значение, Delta -
+/// префиксная сумма шагов внутри регистра плюс перенос из предыдущих 8 строк
+template <typename Sink>
+void visit_id_block_offsets(const PackedIdColumn& column, size_t b, Sink&& sink) {
+    const IdBlock& block = column.block(b);
+    constexpr auto widths = std::make_index_sequence<33>{};
+    if (block.encoding != IdEncoding::Delta) {
+        unpack_id_block_dispatch(block.bits, column.block_words(b), sink, widths);
+        return;
+    }
+
+    const __m256i step = _mm256_set1_epi32(static_cast<int>(block.delta));
+    __m256i carry = _mm256_set1_epi32(-static_cast<int>(block.delta)); // строка 0: смещение 0, а не delta
+    auto scan = [&](__m256i steps, unsigned d) {
+        __m256i x = _mm256_add_epi32(steps, step);
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        const __m256i low_total = _mm256_shuffle_epi32(x, 0xFF);
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+        x = _mm256_add_epi32(x, carry);
+        carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+        sink(x, d);
+    };
+    unpack_id_block_dispatch(block.bits, column.block_words(b), scan, widths);
+}
+
+/// Маска строк 8d..8d+7, существующих в блоке из rows строк (неполный последний блок)
+inline __m256i id_lane_mask(size_t rows, unsigned d) {
+    const int valid = static_cast<int>(std::min<size_t>(ID_BLOCK_LANES, rows > d * ID_BLOCK_LANES ? rows - d * ID_BLOCK_LANES : 0));
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(valid), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+#endif
+
+/// Смещения всех строк блока в out (для скалярного пути и полной распаковки)
+inline void decode_id_offsets(const PackedIdColumn& column, size_t b, uint32_t* out) {
+    #ifdef __AVX2__
+    visit_id_block_offsets(column, b, [out](__m256i offsets, unsigned d) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + d * ID_BLOCK_LANES), offsets);
+    });
+    #else
+    const IdBlock& block = column.block(b);
+    uint32_t offset = 0;
+    for (size_t slot = 0; slot < ID_BLOCK_ROWS; ++slot) {
+        const uint32_t value = packed_id_value(column.block_words(b), block.bits, slot);
+        if (block.encoding == IdEncoding::Delta) {
+            offset += slot ? value + block.delta : 0;
+            out[slot] = offset;
+        } else {
+            out[slot] = value;
+        }
+    }
+    #endif
+}
+
+/// Несжатый эталон: id в [lo, hi]
+inline uint64_t count_i64_in_range(const int64_t* ptr, size_t len, int64_t lo, int64_t hi) {
+    uint64_t count = 0;
+    size_t i = 0;
+
+    #ifdef __AVX2__
+    const __m256i lo_vec = _mm256_set1_epi64x(lo);
+    const __m256i hi_vec = _mm256_set1_epi64x(hi);
+    for (; i + 4 <= len; i += 4) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i));
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(lo_vec, values), _mm256_cmpgt_epi64(values, hi_vec));
+        count += 4 - std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(outside))));
+    }
+    #endif
+
+    for (; i < len; ++i) {
+        count += ptr[i] >= lo && ptr[i] <= hi;
+    }
+    return count;
+}
+
+/// Число id в [lo, hi]: блоки вне диапазона и целиком внутри решаются по заголовку
+inline uint64_t count_ids_in_range(const PackedIdColumn& column, int64_t lo, int64_t hi,
+                                   const ParallelConfig& config = parallel_config()) {
+    if (lo > hi) return 0;
+
+    return parallel_reduce(column.block_count(), uint64_t(0), [&column, lo, hi](size_t start, size_t end) {
+        uint64_t hits = 0;
+        for (size_t b = start; b < end; ++b) {
+            const IdBlock& block = column.block(b);
+            const size_t rows = column.block_rows(b);
+            if (block.encoding == IdEncoding::Raw) {
+                hits += count_i64_in_range(column.block_raw(b), rows, lo, hi);
+                continue;
+            }
+
+            const int64_t block_max = block.base + block.span;
+            if (hi < block.base || lo > block_max) continue;
+            if (lo <= block.base && block_max <= hi) {
+                hits += rows;
+                continue;
+            }
+
+            // Граница диапазона внутри блока - сравнение смещений в u32
+            const uint32_t from = lo > block.base ? static_cast<uint32_t>(lo - block.base) : 0;
+            const uint32_t to = hi < block_max ? static_cast<uint32_t>(hi - block.base) : block.span;
+            #ifdef __AVX2__
+            const __m256i from_vec = _mm256_set1_epi32(static_cast<int>(from));
+            const __m256i to_vec = _mm256_set1_epi32(static_cast<int>(to));
+            visit_id_block_offsets(column, b, [&](__m256i offsets, unsigned d) {
+                __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(offsets, from_vec), offsets),
+                                                  _mm256_cmpeq_epi32(_mm256_min_epu32(offsets, to_vec), offsets));
+                if ((d + 1) * ID_BLOCK_LANES > rows) inside = _mm256_and_si256(inside, id_lane_mask(rows, d));
+                hits += std::popcount(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(inside))));
+            });
+            #else
+            uint32_t offsets[ID_BLOCK_ROWS];
+            decode_id_offsets(column, b, offsets);
+            for (size_t slot = 0; slot < rows; ++slot) hits += offsets[slot] - from <= to - from;
+            #endif
+        }
+        return hits;
+    }, std::plus<uint64_t>(), config);
+}
+
+/// Сумма id (по модулю 2^64): base * rows плюс сумма смещений; сплошной Delta-блок - формулой
+inline int64_t sum_ids(const PackedIdColumn& column, const ParallelConfig& config = parallel_config()) {
+    const uint64_t total = parallel_reduce(column.block_count(), uint64_t(0), [&column](size_t start, size_t end) {
+        uint64_t sum = 0;
+        for (size_t b = start; b < end; ++b) {
+            const IdBlock& block = column.block(b);
+            const size_t rows = column.block_rows(b);
+            if (block.encoding == IdEncoding::Raw) {
+                for (size_t slot = 0; slot < rows; ++slot) sum += static_cast<uint64_t>(column.block_raw(b)[slot]);
+                continue;
+            }
+
+            sum += static_cast<uint64_t>(block.base) * rows;
+            if (block.bits == 0) {
+                if (block.encoding == IdEncoding::Delta) sum += uint64_t(block.delta) * (rows * (rows - 1) / 2);
+                continue;
+            }
+
+            #ifdef __AVX2__
+            __m256i acc = _mm256_setzero_si256();
+            visit_id_block_offsets(column, b, [&](__m256i offsets, unsigned d) {
+                if ((d + 1) * ID_BLOCK_LANES > rows) offsets = _mm256_and_si256(offsets, id_lane_mask(rows, d));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(offsets)));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(offsets, 1)));
+            });
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            #else
+            uint32_t offsets[ID_BLOCK_ROWS];
+            decode_id_offsets(column, b, offsets);
+            for (size_t slot = 0; slot < rows; ++slot) sum += offsets[slot];
+            #endif
+        }
+        return sum;
+    }, std::plus<uint64_t>(), config);
+    return static_cast<int64_t>(total);
+}
+
+struct IdRangeAggregate {
+    uint64_t rows = 0;
+    uint64_t age_sum = 0;
+};
+
+/// Строки с id в [lo, hi] и сумма их возрастов: маска из распакованных id сразу гасит
+/// возрасты 8 строк; блок целиком внутри диапазона - обычный скан возрастов
+inline IdRangeAggregate sum_ages_for_id_range(const PackedIdColumn& ids, const uint8_t* ages, int64_t lo, int64_t hi,
+                                              const ParallelConfig& config = parallel_config()) {
+    if (lo > hi) return IdRangeAggregate{};
+
+    return parallel_reduce(ids.block_count(), IdRangeAggregate{}, [&ids, ages, lo, hi](size_t start, size_t end) {
+        IdRangeAggregate local;
+        for (size_t b = start; b < end; ++b) {
+            const IdBlock& block = ids.block(b);
+            const size_t rows = ids.block_rows(b);
+            const uint8_t* block_ages = ages + b * ID_BLOCK_ROWS;
+            if (block.encoding == IdEncoding::Raw) {
+                for (size_t slot = 0; slot < rows; ++slot) {
+                    const int64_t id = ids.block_raw(b)[slot];
+                    if (id >= lo && id <= hi) {
+                        ++local.rows;
+                        local.age_sum += block_ages[slot];
+                    }
+                }
+                continue;
+            }
+
+            const int64_t block_max = block.base + block.span;
+            if (hi < block.base || lo > block_max) continue;
+            if (lo <= block.base && block_max <= hi) {
+                local.rows += rows;
+                local.age_sum += sum_u8_strided(block_ages, rows, 1);
+                continue;
+            }
+
+            const uint32_t from = lo > block.base ? static_cast<uint32_t>(lo - block.base) : 0;
+            const uint32_t to = hi < block_max ? static_cast<uint32_t>(hi - block.base) : block.span;
+            #ifdef __AVX2__
+            const __m256i from_vec = _mm256_set1_epi32(static_cast<int>(from));
+            const __m256i to_vec = _mm256_set1_epi32(static_cast<int>(to));
+            __m256i age_acc = _mm256_setzero_si256(); // не больше 32 * 255 на полосу
+            visit_id_block_offsets(ids, b, [&](__m256i offsets, unsigned d) {
+                const __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(offsets, from_vec), offsets),
+                                                        _mm256_cmpeq_epi32(_mm256_min_epu32(offsets, to_vec), offsets));
+                const uint8_t* row_ages = block_ages + d * ID_BLOCK_LANES;
+                if ((d + 1) * ID_BLOCK_LANES > rows) {
+                    // Хвост колонки: возрасты за последней строкой читать нельзя
+                    const unsigned hit_mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(inside)));
+                    for (size_t lane = 0; d * ID_BLOCK_LANES + lane < rows; ++lane) {
+                        if ((hit_mask >> lane) & 1) {
+                            ++local.rows;
+                            local.age_sum += row_ages[lane];
+                        }
+                    }
+                    return;
+                }
+                int64_t packed_ages;
+                std::memcpy(&packed_ages, row_ages, sizeof(packed_ages));
+                const __m256i lane_ages = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(packed_ages));
+                age_acc = _mm256_add_epi32(age_acc, _mm256_and_si256(lane_ages, inside));
+                local.rows += std::popcount(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(inside))));
+            });
+            alignas(32) uint32_t lanes[ID_BLOCK_LANES];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), age_acc);
+            for (uint32_t lane_sum : lanes) local.age_sum += lane_sum;
+            #else
+            uint32_t offsets[ID_BLOCK_ROWS];
+            decode_id_offsets(ids, b, offsets);
+            for (size_t slot = 0; slot < rows; ++slot) {
+                if (offsets[slot] - from <= to - from) {
+                    ++local.rows;
+                    local.age_sum += block_ages[slot];
+                }
+            }
+            #endif
+        }
+        return local;
+    }, [](IdRangeAggregate total, const IdRangeAggregate& local) {
+        total.rows += local.rows;
+        total.age_sum += local.age_sum;
+        return total;
+    }, config);
+}
+
+/// BUDGETED SCANS - скан, который можно прервать: токен отмены или дедлайн ⏱️🛑
+/// проверяются перед каждым блоком. Воркеры разбирают блоки по порядку через общий
+/// счётчик, поэтому прерванный скан покрывает ровно префикс [0, rows_scanned).
+constexpr size_t SCAN_CHECK_BLOCK = 256 * 1024;
+
+struct ScanControl {
+    const std::atomic<bool>* cancelled = nullptr;
+    steady_clock::time_point deadline = steady_clock::time_point::max();
+
+    static ScanControl with_budget(nanoseconds budget) {
+        ScanControl control;
+        control.deadline = steady_clock::now() + budget;
+        return control;
+    }
+
+    bool should_stop() const {
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) return true;
+        return deadline != steady_clock::time_point::max() && steady_clock::now() >= deadline;
+    }
+};
+
+template <typename T>
+struct PartialScan {
+    T value;
+    uint64_t rows_scanned = 0;
+    uint64_t rows_total = 0;
+
+    bool complete() const { return rows_scanned == rows_total; }
+    double coverage() const { return rows_total ? static_cast<double>(rows_scanned) / rows_total : 1.0; }
+};
+
+/// kernel(acc, begin, end) добавляет блок [begin, end) в acc; combine сливает аккумуляторы воркеров
+template <typename T, typename BlockKernel, typename Combine>
+PartialScan<T> scan_blocks_budgeted(size_t len, const T& identity, BlockKernel&& kernel, Combine&& combine,
+                                    const ScanControl& control, size_t block = SCAN_CHECK_BLOCK) {
+    struct Lane {
+        T value;
+        uint64_t rows;
+    };
+
+    block = std::max<size_t>(1, block);
+    const size_t blocks = (len + block - 1) / block;
+    std::atomic<size_t> next_block{0};
+
+    // По одной полосе на воркера; блоки раздаются динамически
+    const ParallelConfig& config = parallel_config();
+    Lane total = parallel_reduce(config.width, Lane{identity, 0}, [&](size_t, size_t) {
+        Lane lane{identity, 0};
+        while (!control.should_stop()) {
+            const size_t b = next_block.fetch_add(1, std::memory_order_relaxed);
+            if (b >= blocks) break;
+            const size_t begin = b * block;
+            const size_t end = std::min(len, begin + block);
+            kernel(lane.value, begin, end);
+            lane.rows += end - begin;
+        }
+        return lane;
+    }, [&](Lane acc, const Lane& lane) {
+        acc.value = combine(std::move(acc.value), lane.value);
+        acc.rows += lane.rows;
+        return acc;
+    }, config);
+
+    return PartialScan<T>{std::move(total.value), total.rows, len};
+}
+
+/// Прерываемая сумма: при отмене - сумма по просканированному префиксу
+PartialScan<uint64_t> sum_u8_budgeted(const uint8_t* ptr, size_t len, const ScanControl& control,
+                                      size_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE) {
+    return scan_blocks_budgeted(len, uint64_t(0), [ptr, prefetch_distance](uint64_t& acc, size_t begin, size_t end) {
+        acc += sum_u8_prefetch_range(ptr + begin, end - begin, prefetch_distance);
+    }, std::plus<uint64_t>(), control);
+}
+
+/// APPROXIMATE MODE - оценка по случайной выборке блоков с доверительным интервалом 🎲📊
+/// Блоки по block_rows строк берутся в случайном порядке (частичный Фишер-Йейтс);
+/// оценка - отношение Σсумм/Σстрок по выборке, дисперсия - как у кластерной выборки
+/// с поправкой на конечность. Каждый refine() досэмплирует блоки и сужает интервал,
+/// пройдя все блоки, получаем точный ответ.
+enum class ApproxMetric {
+    SumAges,       // Σ age
+    CountAgeRange, // число строк с lo <= age <= hi
+};
+
+struct ApproxEstimate {
+    double total = 0;          // оценка Σ по всей колонке
+    double mean = 0;           // total / rows
+    double total_low = 0;      // доверительный интервал для total
+    double total_high = 0;
+    uint64_t sampled_rows = 0;
+    size_t sampled_blocks = 0;
+    size_t total_blocks = 0;
+    bool exact = false;        // выборка покрыла все блоки
+
+    double relative_error() const {
+        return total != 0 ? (total_high - total_low) / (2 * std::abs(total)) : (total_high > total_low ? 1.0 : 0.0);
+    }
+};
+
+/// Квантиль стандартного нормального распределения (Абрамовиц-Стиган 26.2.23, ошибка < 4.5e-4)
+inline double normal_quantile(double p) {
+    const double q = p < 0.5 ? p : 1 - p;
+    const double t = std::sqrt(-2 * std::log(q));
+    const double z = t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+                         (1 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+    return p < 0.5 ? -z : z;
+}
+
+class ApproxAggregator {
+private:
+    struct SampleStats {
+        double blocks = 0, y = 0, m = 0, yy = 0, ym = 0, mm = 0;
+
+        void add(double block_value, double block_rows) {
+            blocks += 1;
+            y += block_value;
+            m += block_rows;
+            yy += block_value * block_value;
+            ym += block_value * block_rows;
+            mm += block_rows * block_rows;
+        }
+
+        void merge(const SampleStats& other) {
+            blocks += other.blocks;
+            y += other.y;
+            m += other.m;
+            yy += other.yy;
+            ym += other.ym;
+            mm += other.mm;
+        }
+    };
+
+    const uint8_t* ages;
+    size_t rows;
+    size_t block_rows;
+    ApproxMetric metric;
+    uint8_t lo, hi;
+    double z;
+    std::vector<uint32_t> order; // order[0..next) - уже выбранные блоки
+    size_t next = 0;
+    std::mt19937_64 rng;
+    SampleStats stats;
+
+    uint64_t block_value(const uint8_t* ptr, size_t len) const {
+        return metric == ApproxMetric::SumAges ? sum_u8_prefetch_range(ptr, len, DEFAULT_PREFETCH_DISTANCE)
+                                               : count_u8_in_range(ptr, len, lo, hi);
+    }
+
+public:
+    ApproxAggregator(const uint8_t* ages, size_t rows, ApproxMetric metric = ApproxMetric::SumAges,
+                     uint8_t lo = 0, uint8_t hi = 255, double confidence = 0.95,
+                     size_t block_rows = 4096, uint64_t seed = 42)
+        : ages(ages), rows(rows), block_rows(std::max<size_t>(1, block_rows)), metric(metric), lo(lo), hi(hi),
+          z(normal_quantile(0.5 + std::clamp(confidence, 0.5, 0.999999) / 2)), rng(seed) {
+        order.resize((rows + this->block_rows - 1) / this->block_rows);
+        for (size_t b = 0; b < order.size(); ++b) {
+            order[b] = static_cast<uint32_t>(b);
+        }
+    }
+
+    size_t total_blocks() const { return order.size(); }
+    size_t sampled_blocks() const { return next; }
+    bool done() const { return next == order.size(); }
+
+    /// Досэмплировать ещё до max_blocks блоков (параллельно) и вернуть уточнённую оценку
+    ApproxEstimate refine(size_t max_blocks) {
+        const size_t take = std::min(max_blocks, order.size() - next);
+        for (size_t i = next; i < next + take; ++i) {
+            std::uniform_int_distribution<size_t> pick(i, order.size() - 1);
+            std::swap(order[i], order[pick(rng)]);
+        }
+
+        ParallelConfig config = parallel_config();
+        config.width = std::max<size_t>(1, std::min(config.width, take));
+        const size_t first = next;
+
+        stats.merge(parallel_reduce(take, SampleStats{}, [this, first](size_t start, size_t end) {
+            SampleStats part;
+            for (size_t i = first + start; i < first + end; ++i) {
+                const size_t begin_row = size_t(order[i]) * block_rows;
+                const size_t len = std::min(block_rows, rows - begin_row);
+                part.add(static_cast<double>(block_value(ages + begin_row, len)), static_cast<double>(len));
+            }
+            return part;
+        }, [](SampleStats total, const SampleStats& part) {
+            total.merge(part);
+            return total;
+        }, config));
+        next += take;
+        return estimate();
+    }
+
+    ApproxEstimate estimate() const {
+        ApproxEstimate result;
+        result.sampled_blocks = next;
+        result.total_blocks = order.size();
+        result.sampled_rows = static_cast<uint64_t>(stats.m);
+        result.exact = done();
+        if (stats.m == 0) return result;
+
+        const double ratio = stats.y / stats.m;
+        result.total = ratio * rows;
+        result.mean = ratio;
+
+        double half_width = 0;
+        if (!result.exact && stats.blocks > 1) {
+            const double n = stats.blocks;
+            const double mean_rows = stats.m / n;
+            const double residual = std::max(0.0, stats.yy - 2 * ratio * stats.ym + ratio * ratio * stats.mm) / (n - 1);
+            const double fpc = 1 - n / order.size();
+            half_width = z * std::sqrt(fpc * residual / n) / mean_rows * rows;
+        } else if (!result.exact) {
+            half_width = std::abs(result.total); // по одному блоку интервал не оценить
+        }
+        result.total_low = result.total - half_width;
+        result.total_high = result.total + half_width;
+        return result;
+    }
+};
+
+struct ApproxOptions {
+    double confidence = 0.95;
+    double target_error = 0.01;                // относительная полуширина интервала; 0 - не останавливаться по ошибке
+    double max_sample_rate = 1.0;              // доля блоков, больше которой не сэмплируем
+    nanoseconds time_budget = nanoseconds(0);  // 0 - без ограничения по времени
+    size_t block_rows = 4096;
+    uint64_t seed = 42;
+};
+
+/// Сэмплирует раундами (удваивая выборку), пока не достигнута точность, бюджет времени
+/// или доля выборки. progress(estimate) вызывается после каждого раунда; false - хватит.
+template <typename Progress>
+ApproxEstimate approx_aggregate(const uint8_t* ages, size_t rows, ApproxMetric metric, uint8_t lo, uint8_t hi,
+                                const ApproxOptions& options, Progress&& progress) {
+    const auto start = high_resolution_clock::now();
+    ApproxAggregator aggregator(ages, rows, metric, lo, hi, options.confidence, options.block_rows, options.seed);
+    const size_t max_blocks = static_cast<size_t>(std::ceil(std::clamp(options.max_sample_rate, 0.0, 1.0) * aggregator.total_blocks()));
+
+    ApproxEstimate estimate = aggregator.estimate();
+    size_t round = std::min<size_t>(64, aggregator.total_blocks());
+    while (aggregator.sampled_blocks() < max_blocks) {
+        estimate = aggregator.refine(std::min(round, max_blocks - aggregator.sampled_blocks()));
+        round = aggregator.sampled_blocks();
+
+        if (!progress(estimate)) break;
+        if (estimate.exact) break;
+        if (options.target_error > 0 && estimate.relative_error() <= options.target_error) break;
+        if (options.time_budget.count() > 0 && high_resolution_clock::now() - start >= options.time_budget) break;
+    }
+    return estimate;
+}
+
+inline ApproxEstimate approx_aggregate(const uint8_t* ages, size_t rows, ApproxMetric metric, uint8_t lo, uint8_t hi,
+                                       const ApproxOptions& options) {
+    return approx_aggregate(ages, rows, metric, lo, hi, options, [](const ApproxEstimate&) { return true; });
+}
+
+inline ApproxEstimate approx_avg_age(const std::vector<uint8_t>& ages, const ApproxOptions& options = {}) {
+    return approx_aggregate(ages.data(), ages.size(), ApproxMetric::SumAges, 0, 255, options);
+}
+
+/// Выровненный буфер - нужен для O_DIRECT и зарегистрированных io_uring буферов
+class AlignedBuffer {
+private:
+    char* ptr = nullptr;
+    size_t len = 0;
+
+public:
+    static constexpr size_t ALIGNMENT = 4096;
+
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(size_t size)
+        : ptr(static_cast<char*>(::operator new(size, std::align_val_t{ALIGNMENT}))), len(size) {}
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept : ptr(other.ptr), len(other.len) {
+        other.ptr = nullptr;
+        other.len = 0;
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        std::swap(ptr, other.ptr);
+        std::swap(len, other.len);
+        return *this;
+    }
+
+    ~AlignedBuffer() {
+        if (ptr) ::operator delete(ptr, std::align_val_t{ALIGNMENT});
+    }
+
+    char* data() { return ptr; }
+    size_t size() const { return len; }
+};
+
+inline size_t round_up_to_block(size_t value) {
+    return (value + AlignedBuffer::ALIGNMENT - 1) & ~(AlignedBuffer::ALIGNMENT - 1);
+}
+
+/// fsync по пути: ofstream не отдаёт свой дескриптор, а fsync сбрасывает страницы
+/// файла целиком, через какой бы дескриптор они ни были записаны
+inline bool fsync_path(const std::string& path) {
+    #ifdef BLAZING_HAS_POSIX_IO
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    const bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+    #else
+    return true; // без POSIX остаётся только flush
+    #endif
+}
+
+/// Бэкенд файлового I/O
+enum class IoBackend {
+    Stream,  // std::ofstream / std::ifstream
+    Posix,   // pwrite / pread
+    IoUring  // io_uring с зарегистрированными буферами, fallback на Posix
+};
+
+inline IoBackend io_backend_from_env() {
+    const char* env_backend = std::getenv("IO_BACKEND");
+    if (!env_backend) return IoBackend::Stream;
+    if (std::strcmp(env_backend, "uring") == 0) return IoBackend::IoUring;
+    if (std::strcmp(env_backend, "posix") == 0) return IoBackend::Posix;
+    return IoBackend::Stream;
+}
+
+inline const char* io_backend_name(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::IoUring: return "io_uring";
+        case IoBackend::Posix: return "pwrite/pread";
+        default: return "stream";
+    }
+}
+
+#ifdef BLAZING_HAS_IO_URING
+/// Минимальная обёртка над io_uring на голых системных вызовах (без liburing) 💿⚡
+class IoUring {
+private:
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    size_t sq_len = 0;
+    size_t cq_len = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_len = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned to_submit = 0;
+
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) return;
+
+        sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_len = cq_len = std::max(sq_len, cq_len);
+        }
+
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd, IORING_OFF_SQ_RING);
+        cq_ptr = single_mmap ? sq_ptr
+                             : mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    ring_fd, IORING_OFF_CQ_RING);
+        sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            return;
+        }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        char* cq = static_cast<char*>(cq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() { release(); }
+
+    bool ok() const { return ring_fd >= 0; }
+
+    bool register_buffers(const iovec* iovecs, unsigned count) {
+        return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+    }
+
+    /// Кладёт SQE в кольцо; отправка ядру - в submit()
+    void prepare(uint8_t opcode, int fd, void* addr, unsigned len, uint64_t offset,
+                 uint16_t buf_index, uint64_t user_data) {
+        const unsigned tail = *sq_tail;
+        const unsigned index = tail & *sq_mask;
+
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(addr);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->buf_index = buf_index;
+        sqe->user_data = user_data;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++to_submit;
+    }
+
+    /// Отправляет накопленные SQE и (опционально) ждёт wait_nr завершений
+    int submit(unsigned wait_nr) {
+        for (;;) {
+            int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_nr,
+                                               wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret > 0) to_submit -= std::min<unsigned>(to_submit, ret);
+            return ret;
+        }
+    }
+
+    /// Забирает обратно SQE, которые ещё не отправлены ядру (submit вернул ошибку)
+    void drop_unsubmitted() {
+        __atomic_store_n(sq_tail, *sq_tail - to_submit, __ATOMIC_RELEASE);
+        to_submit = 0;
+    }
+
+    bool pop_completion(uint64_t& user_data, int& res) {
+        const unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+
+        const io_uring_cqe* cqe = &cqes[head & *cq_mask];
+        user_data = cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void release() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_len);
+        if (ring_fd >= 0) close(ring_fd);
+        sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        cq_ptr = sq_ptr = MAP_FAILED;
+        ring_fd = -1;
+    }
+};
+#endif
+
+#ifdef BLAZING_HAS_POSIX_IO
+/// Позиционный блочный файл: кольцо слотов-буферов с несколькими запросами в полёте.
+/// Слоты используются по кругу; wait(slot) освобождает слот перед повторным заполнением.
+class BlazingFile {
+public:
+    struct Options {
+        IoBackend backend = IoBackend::IoUring;
+        bool direct = false;                  // O_DIRECT, мимо page cache
+        size_t buffer_size = 1024 * 1024;     // размер одного слота
+        size_t queue_depth = 4;               // слотов в полёте
+    };
+
+private:
+    struct Slot {
+        AlignedBuffer buffer;
+        bool busy = false;
+        bool write = false;
+        size_t len = 0;
+        uint64_t offset = 0;
+        int64_t result = 0;
+    };
+
+    int fd = -1;
+    Options options;
+    std::vector<Slot> slots;
+    bool write_failed = false; // запись завершилась ошибкой или не целиком
+    #ifdef BLAZING_HAS_IO_URING
+    std::unique_ptr<IoUring> ring;
+    #endif
+
+    // Синхронный pwrite/pread до конца или ошибки
+    int64_t transfer_sync(bool write, char* data, size_t len, uint64_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t ret = write ? pwrite(fd, data + done, len - done, offset + done)
+                                : pread(fd, data + done, len - done, offset + done);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret < 0) return done > 0 ? static_cast<int64_t>(done) : -errno;
+            if (ret == 0) break;
+            done += ret;
+        }
+        return static_cast<int64_t>(done);
+    }
+
+    void complete(size_t slot_index, int64_t res) {
+        Slot& slot = slots[slot_index];
+        // Короткая операция из io_uring - дописываем остаток синхронно; с O_DIRECT
+        // только если остаток начинается на границе блока
+        const bool aligned_rest = !options.direct || res % static_cast<int64_t>(AlignedBuffer::ALIGNMENT) == 0;
+        if (res > 0 && static_cast<size_t>(res) < slot.len && aligned_rest) {
+            int64_t rest = transfer_sync(slot.write, slot.buffer.data() + res, slot.len - res, slot.offset + res);
+            if (rest > 0) res += rest;
+        }
+        // Короткое чтение - это конец файла, короткая запись - потеря данных
+        if (slot.write && res != static_cast<int64_t>(slot.len)) write_failed = true;
+        slot.result = res;
+        slot.busy = false;
+    }
+
+    #ifdef BLAZING_HAS_IO_URING
+    /// Кольцо отказало: забираем завершения всего, что уже ушло в ядро, и дальше
+    /// работаем через pwrite/pread. Слот, чьё завершение получить не удалось,
+    /// завершается с -EIO - буфер не переиспользуется со старым результатом.
+    void abandon_ring() {
+        ring->drop_unsubmitted();
+        for (;;) {
+            const bool in_flight = std::any_of(slots.begin(), slots.end(), [](const Slot& slot) { return slot.busy; });
+            if (!in_flight) break;
+
+            uint64_t user_data;
+            int res;
+            if (ring->pop_completion(user_data, res)) {
+                complete(static_cast<size_t>(user_data), res);
+            } else if (ring->submit(1) < 0) {
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    if (slots[i].busy) complete(i, -EIO);
+                }
+            }
+        }
+        ring.reset();
+        options.backend = IoBackend::Posix;
+    }
+    #endif
+
+public:
+    BlazingFile(const std::string& path, bool for_write, Options opts) : options(opts) {
+        int flags = for_write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+        #ifdef O_DIRECT
+        if (options.direct) flags |= O_DIRECT;
+        #else
+        options.direct = false;
+        #endif
+        fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+
+        options.buffer_size = round_up_to_block(std::max<size_t>(options.buffer_size, AlignedBuffer::ALIGNMENT));
+        options.queue_depth = std::max<size_t>(1, options.queue_depth);
+        slots.resize(options.queue_depth);
+        for (auto& slot : slots) {
+            slot.buffer = AlignedBuffer(options.buffer_size);
+        }
+
+        #ifdef BLAZING_HAS_IO_URING
+        if (options.backend == IoBackend::IoUring) {
+            ring = std::make_unique<IoUring>(static_cast<unsigned>(slots.size()));
+
+            std::vector<iovec> iovecs;
+            for (auto& slot : slots) {
+                iovecs.push_back(iovec{slot.buffer.data(), slot.buffer.size()});
+            }
+
+            if (!ring->ok() || !ring->register_buffers(iovecs.data(), static_cast<unsigned>(iovecs.size()))) {
+                ring.reset();
+            }
+        }
+        if (!ring) options.backend = IoBackend::Posix;
+        #else
+        options.backend = IoBackend::Posix;
+        #endif
+    }
+
+    BlazingFile(const BlazingFile&) = delete;
+    BlazingFile& operator=(const BlazingFile&) = delete;
+
+    ~BlazingFile() {
+        wait_all();
+        if (fd >= 0) close(fd);
+    }
+
+    bool ok() const { return fd >= 0; }
+    IoBackend backend() const { return options.backend; }
+    bool direct() const { return options.direct; }
+    size_t slot_count() const { return slots.size(); }
+    size_t buffer_size() const { return options.buffer_size; }
+    char* buffer(size_t slot) { return slots[slot].buffer.data(); }
+
+    uint64_t size() const {
+        struct stat st;
+        return fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    /// Ставит запись/чтение слота в очередь. Posix-бэкенд выполняет её сразу.
+    void submit(size_t slot_index, bool write, size_t len, uint64_t offset) {
+        Slot& slot = slots[slot_index];
+        slot.busy = true;
+        slot.write = write;
+        slot.len = len;
+        slot.offset = offset;
+
+        #ifdef BLAZING_HAS_IO_URING
+        if (ring) {
+            ring->prepare(write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED, fd, slot.buffer.data(),
+                          static_cast<unsigned>(len), offset, static_cast<uint16_t>(slot_index), slot_index);
+            if (ring->submit(0) >= 0) return;
+            // Этот запрос ядро не получило - он уйдёт через pwrite/pread ниже
+            slot.busy = false;
+            abandon_ring();
+            slot.busy = true;
+        }
+        #endif
+
+        complete(slot_index, transfer_sync(write, slot.buffer.data(), len, offset));
+    }
+
+    /// Ждёт завершения слота; возвращает число переданных байт или -errno
+    int64_t wait(size_t slot_index) {
+        #ifdef BLAZING_HAS_IO_URING
+        while (slots[slot_index].busy && ring) {
+            uint64_t user_data;
+            int res;
+            if (ring->pop_completion(user_data, res)) {
+                complete(static_cast<size_t>(user_data), res);
+            } else if (ring->submit(1) < 0) {
+                abandon_ring(); // завершает все слоты, в том числе этот
+            }
+        }
+        #endif
+        return slots[slot_index].result;
+    }
+
+    /// Ждёт все слоты; false - хотя бы одна запись с открытия файла не дошла целиком
+    bool wait_all() {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            wait(i);
+        }
+        return !write_failed;
+    }
+
+    bool failed() const { return write_failed; }
+
+    /// Барьер долговечности: все запросы завершены, все записи целые и данные на устройстве
+    bool sync() {
+        const bool written = wait_all();
+        return fdatasync(fd) == 0 && written;
+    }
+
+    bool truncate(uint64_t length) {
+        return ftruncate(fd, static_cast<off_t>(length)) == 0;
+    }
+};
+#endif
+
+/// BLAZING FAST I/O - оптимизированный вывод! 🚀💾
+/// В async-режиме продюсер заполняет один буфер, пока фоновый поток пишет
+/// предыдущие; очередь ограничена queue_depth буферами. Бэкенды Posix/IoUring
+/// пишут позиционно через BlazingFile: io_uring держит queue_depth записей
+/// в полёте без отдельного потока.
+class BlazingWriter {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024; // 64KB
+
+    struct Options {
+        size_t buffer_size = DEFAULT_BUFFER_SIZE;
+        bool async = false;
+        size_t queue_depth = 2; // буферов в полёте, не считая заполняемого
+        IoBackend backend = IoBackend::Stream;
+        bool direct = false;    // O_DIRECT, только для Posix/IoUring
+    };
+
+private:
+    struct Chunk {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    std::ofstream file;
+    std::string path;
+    Options options;
+    std::vector<char> buffer;
+    char* buf = nullptr;       // текущий заполняемый буфер
+    size_t buf_capacity = 0;
+    size_t buffer_pos = 0;
+    bool failed = false;
+
+    #ifdef BLAZING_HAS_POSIX_IO
+    std::unique_ptr<BlazingFile> block_file;
+    size_t current_slot = 0;
+    uint64_t file_offset = 0;
+    #endif
+
+    // Async состояние
+    std::thread io_thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Chunk> pending;                 // заполнены, ждут записи
+    std::vector<std::vector<char>> free_buffers; // записаны, можно переиспользовать
+    bool writing = false;
+    bool stopping = false;
+
+    void io_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return; // stopping и всё записано
+
+            Chunk chunk = std::move(pending.front());
+            pending.pop_front();
+            writing = true;
+
+            // Пишем без блокировки - продюсер тем временем форматирует
+            lock.unlock();
+            file.write(chunk.data.data(), chunk.size);
+            lock.lock();
+
+            writing = false;
+            free_buffers.push_back(std::move(chunk.data));
+            cv.notify_all();
+        }
+    }
+
+    #ifdef BLAZING_HAS_POSIX_IO
+    /// Отправляет слот в BlazingFile и переключается на следующий.
+    /// С O_DIRECT пишутся только целые блоки; хвост переносится в новый слот,
+    /// а pad дописывает его нулями (размер файла поправит finish()).
+    void flush_block(bool pad) {
+        const size_t carry = block_file->direct() ? buffer_pos % AlignedBuffer::ALIGNMENT : 0;
+        size_t len = buffer_pos - carry;
+        if (pad && carry > 0) {
+            std::memset(buf + buffer_pos, 0, AlignedBuffer::ALIGNMENT - carry);
+            len += AlignedBuffer::ALIGNMENT;
+        }
+        if (len == 0) return;
+
+        block_file->submit(current_slot, true, len, file_offset);
+
+        const size_t next = (current_slot + 1) % block_file->slot_count();
+        block_file->wait(next);
+        if (block_file->failed()) failed = true;
+        std::memcpy(block_file->buffer(next), buf + buffer_pos - carry, carry);
+
+        file_offset += buffer_pos - carry;
+        current_slot = next;
+        buf = block_file->buffer(next);
+        buffer_pos = carry;
+    }
+    #endif
+
+public:
+    explicit BlazingWriter(const std::string& filename)
+        : BlazingWriter(filename, Options()) {}
+
+    BlazingWriter(const std::string& filename, Options opts)
+        : path(filename), options(opts) {
+        #ifdef BLAZING_HAS_POSIX_IO
+        if (options.backend != IoBackend::Stream) {
+            BlazingFile::Options file_options;
+            file_options.backend = options.backend;
+            file_options.direct = options.direct;
+            file_options.buffer_size = options.buffer_size;
+            file_options.queue_depth = std::max<size_t>(1, options.queue_depth) + 1;
+
+            block_file = std::make_unique<BlazingFile>(filename, true, file_options);
+            if (block_file->ok()) {
+                options.backend = block_file->backend();
+                buf = block_file->buffer(0);
+                buf_capacity = block_file->buffer_size();
+                return;
+            }
+            block_file.reset();
+        }
+        #endif
+        options.backend = IoBackend::Stream;
+
+        file.open(filename, std::ios::binary);
+        file.rdbuf()->pubsetbuf(nullptr, 0); // Unbuffered for maximum control
+        buffer.resize(options.buffer_size);
+        buf = buffer.data();
+        buf_capacity = buffer.size();
+
+        if (options.async) {
+            options.queue_depth = std::max<size_t>(1, options.queue_depth);
+            for (size_t i = 0; i < options.queue_depth; ++i) {
+                free_buffers.emplace_back(options.buffer_size);
+            }
+            io_thread = std::thread(&BlazingWriter::io_loop, this);
+        }
+    }
+
+    BlazingWriter(const BlazingWriter&) = delete;
+    BlazingWriter& operator=(const BlazingWriter&) = delete;
+
+    IoBackend backend() const { return options.backend; }
+
+    void write_line(const std::string& data) {
+        const char* str = data.c_str();
+        size_t len = data.length();
+        
+        if (buffer_pos + len + 1 > buf_capacity) {
+            flush();
+        }
+
+        // Строка длиннее буфера (или хвост O_DIRECT не ушёл) - пишем кусками
+        if (buffer_pos + len + 1 > buf_capacity) {
+            write_bytes(str, len);
+            write_bytes("\n", 1);
+            return;
+        }
+        
+        std::memcpy(buf + buffer_pos, str, len);
+        buffer_pos += len;
+        buf[buffer_pos++] = '\n';
+    }
+
+    /// Сырые байты произвольной длины (колонки датасета и т.п.)
+    void write_bytes(const void* data, size_t len) {
+        const char* src = static_cast<const char*>(data);
+        while (len > 0) {
+            if (buffer_pos == buf_capacity) flush();
+
+            const size_t n = std::min(len, buf_capacity - buffer_pos);
+            std::memcpy(buf + buffer_pos, src, n);
+            buffer_pos += n;
+            src += n;
+            len -= n;
+        }
+    }
+
+    /// APPEND API - форматирование прямо в буфер, без аллокаций ⚡✍️
+    BlazingWriter& append(std::string_view text) {
+        write_bytes(text.data(), text.size());
+        return *this;
+    }
+
+    BlazingWriter& append(char c) {
+        if (buffer_pos == buf_capacity) flush();
+        if (buffer_pos == buf_capacity) {
+            write_bytes(&c, 1);
+        } else {
+            buf[buffer_pos++] = c;
+        }
+        return *this;
+    }
+
+    BlazingWriter& append_uint(uint64_t value) { return append_chars(value); }
+    BlazingWriter& append_int(int64_t value) { return append_chars(value); }
+
+    /// Кратчайшее представление, которое читается обратно в тот же double
+    BlazingWriter& append_double(double value) { return append_chars(value); }
+
+    /// Фиксированное число знаков после точки (как %.Nf)
+    BlazingWriter& append_fixed(double value, int precision) {
+        return append_chars(value, std::chars_format::fixed, precision);
+    }
+
+    BlazingWriter& end_line() { return append('\n'); }
+
+private:
+    /// Дописывает всё отданное в ОС; durable - ещё и сбрасывает на устройство
+    bool finish(bool durable) {
+        #ifdef BLAZING_HAS_POSIX_IO
+        if (block_file) {
+            const uint64_t logical_size = file_offset + buffer_pos;
+            flush_block(true);
+            if (!(durable ? block_file->sync() : block_file->wait_all())) failed = true;
+            if (block_file->direct() && !block_file->truncate(logical_size)) failed = true;
+            return !failed;
+        }
+        #endif
+
+        flush();
+
+        if (options.async) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return pending.empty() && !writing; });
+        }
+
+        file.flush();
+        if (durable && !fsync_path(path)) failed = true;
+        return !failed && file.good();
+    }
+
+    /// std::to_chars прямо в буфер; если места нет даже после flush
+    /// (хвост O_DIRECT) - через стековый буфер
+    template <typename... Args>
+    BlazingWriter& append_chars(Args... args) {
+        constexpr size_t MAX_CHARS = 64;
+        if (buf_capacity - buffer_pos < MAX_CHARS) flush();
+
+        if (buf_capacity - buffer_pos >= MAX_CHARS) {
+            auto [end, ec] = std::to_chars(buf + buffer_pos, buf + buf_capacity, args...);
+            if (ec == std::errc()) {
+                buffer_pos = end - buf;
+                return *this;
+            }
+        }
+
+        char tmp[MAX_CHARS * 8];
+        auto [end, ec] = std::to_chars(tmp, tmp + sizeof(tmp), args...);
+        if (ec == std::errc()) write_bytes(tmp, end - tmp);
+        return *this;
+    }
+
+public:
+
+    /// Отдаёт текущий буфер на запись. В async-режиме блокирует только
+    /// когда все queue_depth буферов ещё в полёте.
+    void flush() {
+        if (buffer_pos == 0) return;
+
+        #ifdef BLAZING_HAS_POSIX_IO
+        if (block_file) {
+            flush_block(false);
+            return;
+        }
+        #endif
+
+        if (!options.async) {
+            file.write(buf, buffer_pos);
+            buffer_pos = 0;
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !free_buffers.empty(); });
+
+        pending.push_back(Chunk{std::move(buffer), buffer_pos});
+        buffer = std::move(free_buffers.back());
+        free_buffers.pop_back();
+        buf = buffer.data();
+        buffer_pos = 0;
+        cv.notify_all();
+    }
+
+    /// Барьер долговечности: возвращается, когда всё записанное до вызова лежит
+    /// на устройстве (fdatasync/fsync); false - какая-то запись потеряна
+    bool sync() { return finish(true); }
+
+    ~BlazingWriter() {
+        finish(false); // деструктор только дописывает, без fsync
+
+        if (io_thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cv.notify_all();
+            io_thread.join();
+        }
+    }
+};
+
+/// Колоночные файлы датасета: сырые массивы фиксированной ширины 💾
+template <typename T>
+bool save_column(const std::string& path, const std::vector<T>& column,
+                 const BlazingWriter::Options& options) {
+    BlazingWriter writer(path, options);
+    writer.write_bytes(column.data(), column.size() * sizeof(T));
+    return writer.sync();
+}
+
+/// Загрузка колонки: queue_depth чтений в полёте, потребляем по порядку
+template <typename T>
+bool load_column(const std::string& path, std::vector<T>& column, const BlazingWriter::Options& options) {
+    #ifdef BLAZING_HAS_POSIX_IO
+    if (options.backend != IoBackend::Stream) {
+        BlazingFile::Options file_options;
+        file_options.backend = options.backend;
+        file_options.direct = options.direct;
+        file_options.buffer_size = std::max<size_t>(options.buffer_size, 1024 * 1024);
+        file_options.queue_depth = std::max<size_t>(1, options.queue_depth) + 1;
+
+        BlazingFile file(path, false, file_options);
+        if (!file.ok()) return false;
+
+        const uint64_t size = file.size();
+        if (size % sizeof(T) != 0) return false;
+        column.resize(size / sizeof(T));
+        char* dst = reinterpret_cast<char*>(column.data());
+
+        const size_t block = file.buffer_size();
+        uint64_t next_offset = 0;
+        auto submit_next = [&](size_t slot) {
+            if (next_offset >= size) return;
+            size_t len = static_cast<size_t>(std::min<uint64_t>(block, size - next_offset));
+            if (file.direct()) len = round_up_to_block(len);
+            file.submit(slot, false, len, next_offset);
+            next_offset += block;
+        };
+
+        for (size_t slot = 0; slot < file.slot_count(); ++slot) {
+            submit_next(slot);
+        }
+
+        size_t slot = 0;
+        for (uint64_t offset = 0; offset < size; offset += block) {
+            const size_t expected = static_cast<size_t>(std::min<uint64_t>(block, size - offset));
+            const int64_t got = file.wait(slot);
+            if (got < static_cast<int64_t>(expected)) {
+                file.wait_all();
+                return false;
+            }
+
+            std::memcpy(dst + offset, file.buffer(slot), expected);
+            submit_next(slot);
+            slot = (slot + 1) % file.slot_count();
+        }
+        return true;
+    }
+    #endif
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+
+    const auto size = static_cast<size_t>(in.tellg());
+    if (size % sizeof(T) != 0) return false;
+    column.resize(size / sizeof(T));
+    in.seekg(0);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(column.data()), size));
+}
+
+/// SHARD=k/n - строки, чей id попадает в k-й из n равных поддиапазонов [min_id, max_id]
+struct IdShard {
+    size_t shard = 0;
+    size_t shards = 1;
+
+    /// Поддиапазон шарда для датасета с id от min_id до max_id
+    struct Range {
+        uint64_t min_id = 0;
+        uint64_t width = 1;
+        size_t shard = 0;
+
+        /// Номер поддиапазона не убывает с id - по нему же ищутся границы в отсортированных id
+        uint64_t slot_of(int64_t id) const { return (static_cast<uint64_t>(id) - min_id) / width; }
+        bool contains(int64_t id) const { return slot_of(id) == shard; }
+    };
+
+    static std::optional<IdShard> parse(std::string_view spec) {
+        const size_t slash = spec.find('/');
+        IdShard result;
+        if (slash == std::string_view::npos ||
+            std::from_chars(spec.data(), spec.data() + slash, result.shard).ec != std::errc() ||
+            std::from_chars(spec.data() + slash + 1, spec.data() + spec.size(), result.shards).ec != std::errc() ||
+            result.shard >= result.shards) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    Range range(int64_t min_id, int64_t max_id) const {
+        const uint64_t base = static_cast<uint64_t>(min_id);
+        return Range{base, (static_cast<uint64_t>(max_id) - base) / shards + 1, shard};
+    }
+};
+
+/// Оставляет в soa только строки шарда - на месте, без второй копии таблицы
+void keep_id_shard(UserSoA& soa, const IdShard& shard) {
+    if (soa.size() == 0) return;
+
+    const auto [min_it, max_it] = std::minmax_element(soa.ids.begin(), soa.ids.end());
+    const IdShard::Range range = shard.range(*min_it, *max_it);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < soa.size(); ++i) {
+        if (!range.contains(soa.ids[i])) continue;
+        if (kept != i) {
+            soa.ids[kept] = soa.ids[i];
+            soa.ages[kept] = soa.ages[i];
+            soa.names[kept] = std::move(soa.names[i]);
+        }
+        ++kept;
+    }
+    soa.resize(kept);
+    soa.ids.shrink_to_fit();
+    soa.names.shrink_to_fit();
+    soa.ages.shrink_to_fit();
+}
+
+/// Шард поверх чужих колонок (shm-сегмент). Отсортированные id - срез без копии;
+/// иначе строки шарда копируются в storage (серверу нужны только id и возраст).
+DatasetView shard_view(DatasetView view, const IdShard& shard, UserSoA& storage) {
+    if (view.rows == 0) return view;
+
+    const int64_t* ids_end = view.ids + view.rows;
+    if (std::is_sorted(view.ids, ids_end)) {
+        const IdShard::Range range = shard.range(view.ids[0], ids_end[-1]);
+        const int64_t* first = std::partition_point(view.ids, ids_end, [&](int64_t id) { return range.slot_of(id) < shard.shard; });
+        const int64_t* last = std::partition_point(first, ids_end, [&](int64_t id) { return range.slot_of(id) <= shard.shard; });
+        const size_t begin = static_cast<size_t>(first - view.ids);
+        return DatasetView{first, view.ages + begin, static_cast<size_t>(last - first)};
+    }
+
+    const auto [min_it, max_it] = std::minmax_element(view.ids, ids_end);
+    const IdShard::Range range = shard.range(*min_it, *max_it);
+    storage = UserSoA{};
+    for (size_t i = 0; i < view.rows; ++i) {
+        if (!range.contains(view.ids[i])) continue;
+        storage.ids.push_back(view.ids[i]);
+        storage.ages.push_back(view.ages[i]);
+    }
+    return DatasetView::of(storage);
+}
+
+/// Датасет на диске: ids.bin, ages.bin, names.bin (байты имён подряд) и
+/// name_offsets.bin (uint64_t[rows + 1] в names.bin) - как в shm-сегменте,
+/// так что имя может содержать любые байты, в том числе перевод строки
+bool save_dataset(const std::string& dir, const UserSoA& soa, const BlazingWriter::Options& options) {
+    bool ok = save_column(dir + "/ids.bin", soa.ids, options);
+    ok = save_column(dir + "/ages.bin", soa.ages, options) && ok;
+
+    std::vector<uint64_t> name_offsets(soa.names.size() + 1, 0);
+    for (size_t i = 0; i < soa.names.size(); ++i) {
+        name_offsets[i + 1] = name_offsets[i] + soa.names[i].size();
+    }
+    ok = save_column(dir + "/name_offsets.bin", name_offsets, options) && ok;
+
+    BlazingWriter names(dir + "/names.bin", options);
+    for (const auto& name : soa.names) {
+        names.write_bytes(name.data(), name.size());
+    }
+    return names.sync() && ok;
+}
+
+/// С shard в памяти остаются только строки шарда: колонки фильтруются на месте,
+/// строки имён создаются только для своих строк
+bool load_dataset(const std::string& dir, UserSoA& soa, const BlazingWriter::Options& options,
+                  const IdShard* shard = nullptr) {
+    std::vector<uint64_t> name_offsets;
+    std::vector<char> names_blob;
+    if (!load_column(dir + "/ids.bin", soa.ids, options) ||
+        !load_column(dir + "/ages.bin", soa.ages, options) ||
+        !load_column(dir + "/name_offsets.bin", name_offsets, options) ||
+        !load_column(dir + "/names.bin", names_blob, options)) {
+        return false;
+    }
+
+    if (soa.ages.size() != soa.ids.size() || name_offsets.size() != soa.ids.size() + 1 ||
+        name_offsets.front() != 0 || name_offsets.back() != names_blob.size()) {
+        return false;
+    }
+
+    const size_t rows = soa.ids.size();
+    IdShard::Range range;
+    if (shard && rows > 0) {
+        const auto [min_it, max_it] = std::minmax_element(soa.ids.begin(), soa.ids.end());
+        range = shard->range(*min_it, *max_it);
+    }
+
+    soa.names.clear();
+    soa.names.reserve(shard ? rows / shard->shards + 1 : rows);
+    size_t kept = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        if (name_offsets[i + 1] < name_offsets[i]) return false;
+        if (shard && !range.contains(soa.ids[i])) continue;
+        soa.ids[kept] = soa.ids[i];
+        soa.ages[kept] = soa.ages[i];
+        soa.names.emplace_back(names_blob.data() + name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+        ++kept;
+    }
+
+    if (shard) {
+        soa.ids.resize(kept);
+        soa.ages.resize(kept);
+        soa.ids.shrink_to_fit();
+        soa.ages.shrink_to_fit();
+    }
+    return true;
+}
+
+/// CSV/TSV EXPORT - каждый поток форматирует свой диапазон строк 📤⚡
+struct CsvExportOptions {
+    char delimiter = ',';
+    bool header = true;
+    size_t num_threads = 0;               // 0 - hardware_concurrency
+    size_t buffer_size = 4 * 1024 * 1024; // локальный буфер потока
+};
+
+inline size_t count_digits(uint64_t value) {
+    size_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+inline bool csv_needs_quotes(std::string_view field, char delimiter) {
+    for (char c : field) {
+        if (c == delimiter || c == '"' || c == '\n' || c == '\r') return true;
+    }
+    return false;
+}
+
+/// Точная длина строки id,name,age\n - нужна для смещений pwrite
+inline size_t csv_row_length(const UserSoA& soa, size_t row, char delimiter) {
+    const int64_t id = soa.ids[row];
+    size_t len = count_digits(id < 0 ? 0 - static_cast<uint64_t>(id) : static_cast<uint64_t>(id)) + (id < 0);
+
+    const std::string& name = soa.names[row];
+    len += name.size();
+    if (csv_needs_quotes(name, delimiter)) {
+        len += 2 + std::count(name.begin(), name.end(), '"');
+    }
+
+    return len + count_digits(soa.ages[row]) + 3; // два разделителя и '\n'
+}
+
+inline char* format_csv_row(char* out, const UserSoA& soa, size_t row, char delimiter) {
+    out = std::to_chars(out, out + 20, soa.ids[row]).ptr;
+    *out++ = delimiter;
+
+    const std::string& name = soa.names[row];
+    if (csv_needs_quotes(name, delimiter)) {
+        *out++ = '"';
+        for (char c : name) {
+            if (c == '"') *out++ = '"';
+            *out++ = c;
+        }
+        *out++ = '"';
+    } else {
+        std::memcpy(out, name.data(), name.size());
+        out += name.size();
+    }
+
+    *out++ = delimiter;
+    out = std::to_chars(out, out + 3, soa.ages[row]).ptr;
+    *out++ = '\n';
+    return out;
+}
+
+/// Форматирует строки [begin, end) в buffer и отдаёт каждый заполненный кусок в sink
+template <typename Sink>
+void format_csv_range(const UserSoA& soa, size_t begin, size_t end, char delimiter,
+                      std::vector<char>& buffer, Sink&& sink) {
+    char* pos = buffer.data();
+    char* const limit = buffer.data() + buffer.size();
+
+    for (size_t row = begin; row < end; ++row) {
+        // Худший случай: все символы имени в кавычках
+        const size_t worst = 20 + 3 + 2 * soa.names[row].size() + 2 + 3;
+        if (static_cast<size_t>(limit - pos) < worst) {
+            sink(buffer.data(), static_cast<size_t>(pos - buffer.data()));
+            pos = buffer.data();
+            if (buffer.size() < worst) {
+                buffer.resize(worst);
+                pos = buffer.data();
+            }
+        }
+        pos = format_csv_row(pos, soa, row, delimiter);
+    }
+
+    if (pos != buffer.data()) {
+        sink(buffer.data(), static_cast<size_t>(pos - buffer.data()));
+    }
+}
+
+/// Экспорт UserSoA в CSV/TSV. На POSIX: проход 1 считает байты каждого
+/// диапазона, префиксная сумма даёт смещения, проход 2 форматирует и пишет
+/// pwrite параллельно. Иначе - волнами через BlazingWriter по порядку.
+bool export_users_csv(const std::string& path, const UserSoA& soa, const CsvExportOptions& options) {
+    const size_t rows = soa.ids.size();
+    const size_t num_threads = options.num_threads ? options.num_threads
+                                                   : std::max(1u, std::thread::hardware_concurrency());
+    const char delimiter = options.delimiter;
+
+    std::string header;
+    if (options.header) {
+        header = std::string("id") + delimiter + "name" + delimiter + "age\n";
+    }
+
+    // Диапазоны по ~1M строк - баланс нагрузки при неравных длинах имён
+    const size_t rows_per_range = std::max<size_t>(1, std::min<size_t>(1 << 20, (rows + num_threads - 1) / num_threads));
+    const size_t num_ranges = (rows + rows_per_range - 1) / rows_per_range;
+
+    #ifdef BLAZING_HAS_POSIX_IO
+    // Раздаём диапазоны потокам через атомарный счётчик
+    auto run_parallel = [&](auto&& per_range) {
+        std::atomic<size_t> next_range{0};
+        std::vector<std::future<bool>> futures;
+        for (size_t t = 0; t < std::min(num_threads, std::max<size_t>(1, num_ranges)); ++t) {
+            futures.push_back(std::async(std::launch::async, [&]() {
+                std::vector<char> buffer(options.buffer_size);
+                bool ok = true;
+                for (size_t r; (r = next_range.fetch_add(1)) < num_ranges;) {
+                    ok = per_range(r, r * rows_per_range, std::min(rows, (r + 1) * rows_per_range), buffer) && ok;
+                }
+                return ok;
+            }));
+        }
+        bool ok = true;
+        for (auto& future : futures) {
+            ok = future.get() && ok;
+        }
+        return ok;
+    };
+
+    std::vector<uint64_t> offsets(num_ranges + 1, 0);
+    run_parallel([&](size_t r, size_t begin, size_t end, std::vector<char>&) {
+        uint64_t bytes = 0;
+        for (size_t row = begin; row < end; ++row) {
+            bytes += csv_row_length(soa, row, delimiter);
+        }
+        offsets[r + 1] = bytes;
+        return true;
+    });
+
+    offsets[0] = header.size();
+    for (size_t r = 0; r < num_ranges; ++r) {
+        offsets[r + 1] += offsets[r];
+    }
+
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = ftruncate(fd, static_cast<off_t>(offsets[num_ranges])) == 0;
+    ok = ok && pwrite(fd, header.data(), header.size(), 0) == static_cast<ssize_t>(header.size());
+
+    ok = run_parallel([&](size_t r, size_t begin, size_t end, std::vector<char>& buffer) {
+        uint64_t offset = offsets[r];
+        bool range_ok = true;
+        format_csv_range(soa, begin, end, delimiter, buffer, [&](const char* data, size_t len) {
+            while (len > 0) {
+                ssize_t written = pwrite(fd, data, len, static_cast<off_t>(offset));
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) {
+                    range_ok = false;
+                    return;
+                }
+                data += written;
+                len -= written;
+                offset += written;
+            }
+        });
+        return range_ok && offset == offsets[r + 1];
+    }) && ok;
+
+    return close(fd) == 0 && ok;
+    #else
+    // Волна = num_threads диапазонов, форматируем параллельно, пишем по порядку
+    BlazingWriter writer(path);
+    writer.append(header);
+
+    std::vector<std::vector<char>> range_output(num_ranges);
+    for (size_t wave = 0; wave < num_ranges; wave += num_threads) {
+        const size_t wave_end = std::min(num_ranges, wave + num_threads);
+        std::vector<std::future<void>> futures;
+        for (size_t r = wave; r < wave_end; ++r) {
+            futures.push_back(std::async(std::launch::async, [&, r]() {
+                std::vector<char> buffer(options.buffer_size);
+                const size_t begin = r * rows_per_range;
+                const size_t end = std::min(rows, begin + rows_per_range);
+                format_csv_range(soa, begin, end, delimiter, buffer, [&](const char* data, size_t len) {
+                    range_output[r].insert(range_output[r].end(), data, data + len);
+                });
+            }));
+        }
+        for (size_t r = wave; r < wave_end; ++r) {
+            futures[r - wave].get();
+            writer.write_bytes(range_output[r].data(), range_output[r].size());
+            std::vector<char>().swap(range_output[r]);
+        }
+    }
+    return writer.sync();
+    #endif
+}
+
+/// Файл целиком в памяти: mmap на POSIX, иначе чтение в буфер 🗺️
+class MappedFile {
+private:
+    const char* ptr = nullptr;
+    size_t len = 0;
+    std::vector<char> fallback;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        #ifdef BLAZING_HAS_POSIX_IO
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                ptr = static_cast<const char*>(mapped);
+                len = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+        #else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return;
+        fallback.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        if (in.read(fallback.data(), fallback.size())) {
+            ptr = fallback.data();
+            len = fallback.size();
+        }
+        #endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        #ifdef BLAZING_HAS_POSIX_IO
+        if (ptr) munmap(const_cast<char*>(ptr), len);
+        #endif
+    }
+
+    bool ok() const { return ptr != nullptr; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+/// Битовые маски 64-байтового блока: разделители, переводы строк, кавычки, '\r'
+struct CsvBlockMasks {
+    uint64_t delimiter;
+    uint64_t newline;
+    uint64_t quote;
+    uint64_t carriage;
+};
+
+inline CsvBlockMasks csv_block_masks(const char* block, char delimiter) {
+    #ifdef __AVX2__
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    auto mask_of = [&](char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        const uint32_t low_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+        const uint32_t high_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+        return static_cast<uint64_t>(low_bits) | (static_cast<uint64_t>(high_bits) << 32);
+    };
+    return {mask_of(delimiter), mask_of('\n'), mask_of('"'), mask_of('\r')};
+    #else
+    CsvBlockMasks masks{0, 0, 0, 0};
+    for (int i = 0; i < 64; ++i) {
+        masks.delimiter |= static_cast<uint64_t>(block[i] == delimiter) << i;
+        masks.newline |= static_cast<uint64_t>(block[i] == '\n') << i;
+        masks.quote |= static_cast<uint64_t>(block[i] == '"') << i;
+        masks.carriage |= static_cast<uint64_t>(block[i] == '\r') << i;
+    }
+    return masks;
+    #endif
+}
+
+/// Префиксный XOR: бит i = чётность кавычек в [0, i] - маска "внутри кавычек"
+inline uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+inline int ctz64(uint64_t bits) {
+    #ifdef _MSC_VER
+    return static_cast<int>(_tzcnt_u64(bits));
+    #else
+    return __builtin_ctzll(bits);
+    #endif
+}
+
+inline int popcount64(uint64_t bits) {
+    #ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(bits));
+    #else
+    return __builtin_popcountll(bits);
+    #endif
+}
+
+/// Обходит [begin, end) блоками по 64 байта; хвост копируется в буфер с нулями
+template <typename Visitor>
+void for_each_csv_block(const char* begin, const char* end, char delimiter, Visitor&& visit) {
+    const char* pos = begin;
+    for (; pos + 64 <= end; pos += 64) {
+        visit(pos, csv_block_masks(pos, delimiter), uint64_t(~0ULL));
+    }
+    if (pos < end) {
+        alignas(64) char tail[64] = {};
+        const size_t n = static_cast<size_t>(end - pos);
+        std::memcpy(tail, pos, n);
+        visit(pos, csv_block_masks(tail, delimiter), (1ULL << n) - 1);
+    }
+}
+
+/// SWAR: 8 ASCII-цифр (старшая цифра в младшем байте) -> число за 3 умножения
+inline uint64_t parse_eight_digits_swar(uint64_t chunk) {
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFULL;
+    return chunk;
+}
+
+inline bool is_eight_digits_swar(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+/// До 19 цифр кусками по 8 (первый кусок дополняется ведущими '0'); больше max - ошибка
+inline bool parse_uint_swar(const char* p, size_t len, uint64_t& out,
+                            uint64_t max = std::numeric_limits<uint64_t>::max()) {
+    if (len == 0 || len > 19) return false;
+
+    uint64_t value = 0;
+    size_t head = len % 8 ? len % 8 : 8;
+    while (len > 0) {
+        uint64_t chunk = 0x3030303030303030ULL;
+        std::memcpy(reinterpret_cast<char*>(&chunk) + (8 - head), p, head);
+        if (!is_eight_digits_swar(chunk)) return false;
+
+        value = value * 100000000ULL + parse_eight_digits_swar(chunk);
+        p += head;
+        len -= head;
+        head = 8;
+    }
+
+    if (value > max) return false; // 19 цифр в uint64_t помещаются всегда
+    out = value;
+    return true;
+}
+
+inline bool parse_int_swar(const char* p, size_t len, int64_t& out) {
+    const bool negative = len > 0 && *p == '-';
+    const uint64_t max_magnitude = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + negative;
+    uint64_t magnitude;
+    if (!parse_uint_swar(p + negative, len - negative, magnitude, max_magnitude)) return false;
+    out = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+inline std::string csv_unquote(const char* p, size_t len) {
+    if (len < 2 || p[0] != '"' || p[len - 1] != '"') return std::string(p, len);
+
+    std::string field;
+    field.reserve(len - 2);
+    for (size_t i = 1; i + 1 < len; ++i) {
+        field.push_back(p[i]);
+        if (p[i] == '"' && p[i + 1] == '"') ++i;
+    }
+    return field;
+}
+
+/// Пустая строка ("" или "\r") - пропускается и не занимает строку в soa
+inline bool is_blank_csv_line(const char* line_start, const char* line_end) {
+    return line_end == line_start || (line_end == line_start + 1 && *line_start == '\r');
+}
+
+/// Переводы строк, которыми кончаются пустые строки: перед '\n' стоит конец прошлой
+/// строки или "\n\r". line_start - предыдущий байт блока был таким концом (или начало
+/// сегмента); blank_cr - предыдущий байт был '\r' в начале строки.
+inline uint64_t blank_csv_line_ends(uint64_t newlines, uint64_t carriages, bool& line_start, bool& blank_cr) {
+    const uint64_t after_newline = (newlines << 1) | (line_start ? 1 : 0);
+    const uint64_t lone_cr = carriages & after_newline;
+    const uint64_t blank = newlines & (after_newline | (lone_cr << 1) | (blank_cr ? 1 : 0));
+    line_start = (newlines >> 63) & 1;
+    blank_cr = (lone_cr >> 63) & 1;
+    return blank;
+}
+
+/// Разбирает строки сегмента в soa в строки [row, row_end) (сегмент начинается с начала
+/// строки). Строк больше, чем насчитал подсчёт, или оборванная кавычка - ошибка, без записи.
+inline bool parse_csv_segment(const char* begin, const char* end, char delimiter,
+                              UserSoA& soa, size_t row, size_t row_end) {
+    const char* field_start = begin;
+    int field = 0;
+    bool in_quote = false;
+    bool ok = true;
+
+    auto finish_field = [&](const char* field_end) {
+        if (row >= row_end) {
+            ok = false;
+            return;
+        }
+        size_t len = static_cast<size_t>(field_end - field_start);
+        if (field == 0) {
+            ok = ok && parse_int_swar(field_start, len, soa.ids[row]);
+        } else if (field == 1) {
+            soa.names[row] = csv_unquote(field_start, len);
+        } else if (field == 2) {
+            uint64_t age = 0;
+            if (len > 0 && field_start[len - 1] == '\r') --len;
+            ok = ok && parse_uint_swar(field_start, len, age, 255);
+            soa.ages[row] = static_cast<uint8_t>(age);
+        } else {
+            ok = false;
+        }
+    };
+
+    for_each_csv_block(begin, end, delimiter, [&](const char* block, const CsvBlockMasks& masks, uint64_t valid) {
+        const uint64_t quoted = prefix_xor(masks.quote & valid) ^ (in_quote ? ~0ULL : 0);
+        in_quote = (quoted >> 63) & 1;
+
+        uint64_t structural = (masks.delimiter | masks.newline) & valid & ~quoted;
+        while (structural) {
+            const int bit = ctz64(structural);
+            structural &= structural - 1;
+
+            const char* p = block + bit;
+            if (*p == '\n' && field == 0 && is_blank_csv_line(field_start, p)) {
+                field_start = p + 1;
+                continue;
+            }
+            finish_field(p);
+            field_start = p + 1;
+
+            if (*p == '\n') {
+                ok = ok && field == 2;
+                field = 0;
+                ++row;
+            } else {
+                ++field;
+            }
+        }
+    });
+
+    // Последняя строка без '\n' (в том числе оборванная на пустом поле)
+    if (field > 0 || !is_blank_csv_line(field_start, end)) {
+        finish_field(end);
+        ok = ok && field == 2;
+        ++row;
+    }
+    return ok && !in_quote && row == row_end;
+}
+
+/// SIMD CSV IMPORT - id,name,age прямо в колонки UserSoA 📥⚡
+/// Файл режется на куски по числу потоков; чётность кавычек каждого куска
+/// даёт состояние на его границе, по нему находится первая настоящая
+/// '\n' - граница сегмента. Подсчёт строк -> смещения -> параллельный разбор.
+bool import_users_csv(const std::string& path, UserSoA& soa, char delimiter = ',') {
+    MappedFile file(path);
+    if (!file.ok()) return false;
+
+    const char* data = file.data();
+    const char* const data_end = data + file.size();
+
+    // Заголовок: первая непустая строка, не начинающаяся с цифры
+    while (data < data_end && (*data == '\n' || *data == '\r')) ++data;
+    if (data < data_end && !(std::isdigit(static_cast<unsigned char>(*data)) || *data == '-')) {
+        const char* nl = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(data_end - data)));
+        data = nl ? nl + 1 : data_end;
+    }
+
+    const size_t bytes = static_cast<size_t>(data_end - data);
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t num_chunks = std::max<size_t>(1, std::min(num_threads * 4, bytes / (1 << 20)));
+    const size_t chunk_bytes = (bytes + num_chunks - 1) / num_chunks;
+
+    auto run_chunks = [&](auto&& per_chunk) {
+        std::vector<std::future<void>> futures;
+        for (size_t t = 0; t < std::min(num_threads, num_chunks); ++t) {
+            futures.push_back(std::async(std::launch::async, [&, t]() {
+                for (size_t c = t; c < num_chunks; c += num_threads) per_chunk(c);
+            }));
+        }
+        for (auto& future : futures) future.get();
+    };
+    auto chunk_begin = [&](size_t c) { return data + std::min(bytes, c * chunk_bytes); };
+
+    // Проход 1: чётность кавычек каждого куска
+    std::vector<uint8_t> quote_parity(num_chunks, 0);
+    run_chunks([&](size_t c) {
+        uint64_t quotes = 0;
+        for_each_csv_block(chunk_begin(c), chunk_begin(c + 1), delimiter,
+                           [&](const char*, const CsvBlockMasks& masks, uint64_t valid) {
+            quotes += popcount64(masks.quote & valid);
+        });
+        quote_parity[c] = quotes & 1;
+    });
+
+    std::vector<uint8_t> starts_in_quote(num_chunks, 0);
+    for (size_t c = 1; c < num_chunks; ++c) {
+        starts_in_quote[c] = starts_in_quote[c - 1] ^ quote_parity[c - 1];
+    }
+    // Нечётное число кавычек - файл кончается внутри кавычек, границы и подсчёт строк неверны
+    if (starts_in_quote[num_chunks - 1] ^ quote_parity[num_chunks - 1]) return false;
+
+    // Проход 2: граница сегмента = после первой '\n' вне кавычек в куске
+    // (не нашлась - сегмент пуст); заодно считаем строки сегмента
+    std::vector<const char*> boundaries(num_chunks + 1, data_end);
+    boundaries[0] = data;
+    run_chunks([&](size_t c) {
+        if (c == 0) return;
+        bool in_quote = starts_in_quote[c];
+        bool found = false;
+        for_each_csv_block(chunk_begin(c), chunk_begin(c + 1), delimiter,
+                           [&](const char* block, const CsvBlockMasks& masks, uint64_t valid) {
+            const uint64_t quoted = prefix_xor(masks.quote & valid) ^ (in_quote ? ~0ULL : 0);
+            in_quote = (quoted >> 63) & 1;
+            const uint64_t newlines = masks.newline & valid & ~quoted;
+            if (!found && newlines) {
+                boundaries[c] = block + ctz64(newlines) + 1;
+                found = true;
+            }
+        });
+        if (!found) boundaries[c] = nullptr;
+    });
+    // Кусок без '\n' наследует границу следующего
+    for (size_t c = num_chunks; c-- > 1;) {
+        if (!boundaries[c]) boundaries[c] = boundaries[c + 1];
+    }
+
+    std::vector<size_t> segment_rows(num_chunks + 1, 0);
+    run_chunks([&](size_t c) {
+        const char* begin = boundaries[c];
+        const char* end = boundaries[c + 1];
+        if (begin >= end) return;
+
+        // Внутри сегмента кавычки сбалансированы: он начинается с начала строки.
+        // Пустые строки не считаются - parse_csv_segment их пропускает
+        bool in_quote = false;
+        bool line_start = true, blank_cr = false;
+        size_t rows = 0;
+        for_each_csv_block(begin, end, delimiter, [&](const char*, const CsvBlockMasks& masks, uint64_t valid) {
+            const uint64_t quoted = prefix_xor(masks.quote & valid) ^ (in_quote ? ~0ULL : 0);
+            in_quote = (quoted >> 63) & 1;
+            const uint64_t newlines = masks.newline & valid & ~quoted;
+            rows += popcount64(newlines & ~blank_csv_line_ends(newlines, masks.carriage & valid & ~quoted, line_start, blank_cr));
+        });
+        // Хвост без '\n' - строка, если он не пуст (иначе ошибку найдёт разбор)
+        const char* last_line = end;
+        while (last_line > begin && last_line[-1] != '\n') --last_line;
+        segment_rows[c + 1] = rows + !is_blank_csv_line(last_line, end);
+    });
+
+    // Префиксная сумма -> стартовая строка сегмента; колонки растут один раз
+    const size_t base = soa.size();
+    segment_rows[0] = base;
+    for (size_t c = 0; c < num_chunks; ++c) {
+        segment_rows[c + 1] += segment_rows[c];
+    }
+    soa.resize(segment_rows[num_chunks]);
+
+    // Проход 3: параллельный разбор в свои строки
+    std::atomic<bool> ok{true};
+    run_chunks([&](size_t c) {
+        if (boundaries[c] < boundaries[c + 1] &&
+            !parse_csv_segment(boundaries[c], boundaries[c + 1], delimiter, soa, segment_rows[c], segment_rows[c + 1])) {
+            ok = false;
+        }
+    });
+
+    if (!ok) soa.resize(base);
+    return ok;
+}
+
+/// ULTRA FAST печать без аллокаций! ⚡📊
+void print_results_ultra_fast(std::string_view name, uint64_t avg_age, 
+                             uint64_t elapsed_nanos, uint64_t baseline_nanos) {
+    char buffer[256];
+    char* const end = buffer + sizeof(buffer);
+    char* pos = buffer;
+    
+    // Копируем название (урезаем, чтобы цифрам всегда хватило места)
+    const size_t name_len = std::min<size_t>(name.length(), 128);
+    std::memcpy(pos, name.data(), name_len);
+    pos += name_len;
+    
+    // Добавляем ": "
+    *pos++ = ':';
+    *pos++ = ' ';
+    
+    // Добавляем возраст
+    pos = std::to_chars(pos, end, avg_age).ptr;
+    
+    // Добавляем " - "
+    *pos++ = ' ';
+    *pos++ = '-';
+    *pos++ = ' ';
+    
+    // Добавляем время
+    auto append_unit = [&pos](uint64_t value, std::string_view unit) {
+        pos = std::to_chars(pos, pos + 20, value).ptr;
+        std::memcpy(pos, unit.data(), unit.size());
+        pos += unit.size();
+    };
+    if (elapsed_nanos >= 1000000000) {
+        append_unit(elapsed_nanos / 1000000000, "s");
+    } else if (elapsed_nanos >= 1000000) {
+        append_unit(elapsed_nanos / 1000000, "ms");
+    } else if (elapsed_nanos >= 1000) {
+        append_unit(elapsed_nanos / 1000, "us");
+    } else {
+        append_unit(elapsed_nanos, "ns");
+    }
+    
+    // Добавляем ускорение
+    uint64_t speedup = baseline_nanos / std::max<uint64_t>(1, elapsed_nanos);
+    if (speedup > 1) {
+        *pos++ = ' ';
+        *pos++ = '(';
+        append_unit(speedup, "x faster)");
+    }
+    
+    // Один системный вызов
+    std::cout.write(buffer, pos - buffer);
+    std::cout.put('\n');
+}
+
+/// Данные для бенчмарка и сервера: IMPORT_CSV, DATASET_DIR или генерация.
+/// users (AoS) заполняется только если передан. С shard строится только шард:
+/// генерация - сразу его диапазон id, DATASET_DIR - фильтр при загрузке.
+void prepare_dataset(UserSoA& user_soa, std::vector<User>* users, size_t num_users,
+                     const IdShard* shard = nullptr) {
+    // DATASET_DIR: колонки читаются с диска (IO_BACKEND=uring|posix|stream, IO_DIRECT=1)
+    BlazingWriter::Options io_options;
+    io_options.backend = io_backend_from_env();
+    io_options.direct = std::getenv("IO_DIRECT") != nullptr;
+    io_options.buffer_size = 1024 * 1024;
+    io_options.queue_depth = 8;
+
+    const char* dataset_dir = std::getenv("DATASET_DIR");
+    bool dataset_loaded = false;
+
+    // IMPORT_CSV=path: id,name,age из CSV (.tsv - с табуляцией)
+    if (const char* import_path = std::getenv("IMPORT_CSV")) {
+        const std::string_view path_view(import_path);
+        const char delimiter = path_view.size() >= 4 && path_view.substr(path_view.size() - 4) == ".tsv" ? '\t' : ',';
+
+        auto import_start = high_resolution_clock::now();
+        dataset_loaded = import_users_csv(import_path, user_soa, delimiter);
+        auto import_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - import_start);
+
+        if (dataset_loaded) {
+            std::cout << "📥 Imported " << user_soa.size() << " users from " << import_path << " in "
+                      << import_elapsed.count() / 1000000.0 << "ms\n\n";
+            if (shard) keep_id_shard(user_soa, *shard);
+            dataset_dir = nullptr;
+        } else {
+            std::cout << "❌ Failed to import " << import_path << ", generating instead\n\n";
+        }
+    }
+
+    if (dataset_dir) {
+        auto load_start = high_resolution_clock::now();
+        dataset_loaded = load_dataset(dataset_dir, user_soa, io_options, shard);
+        auto load_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - load_start);
+
+        if (dataset_loaded) {
+            std::cout << "💿 Loaded " << user_soa.ids.size() << " users from " << dataset_dir
+                      << " (" << io_backend_name(io_options.backend) << ") in "
+                      << load_elapsed.count() / 1000000.0 << "ms\n\n";
+        } else {
+            user_soa = UserSoA{};
+        }
+    }
+
+    if (!dataset_loaded) {
+        // Генерируемые id - 0..num_users-1, у шарда это один сплошной отрезок
+        size_t first = 0, last = num_users;
+        if (shard && num_users > 0) {
+            const IdShard::Range range = shard->range(0, static_cast<int64_t>(num_users - 1));
+            first = std::min<uint64_t>(num_users, shard->shard * range.width);
+            last = std::min<uint64_t>(num_users, first + range.width);
+        }
+        user_soa.reserve(last - first);
+
+        for (size_t i = first; i < last; ++i) {
+            user_soa.add_user(static_cast<int64_t>(i), "User " + std::to_string(i), static_cast<uint8_t>(i % 100));
+        }
+
+        // Шард - не весь датасет: в DATASET_DIR он не сохраняется
+        if (dataset_dir && !shard) {
+            auto save_start = high_resolution_clock::now();
+            bool saved = save_dataset(dataset_dir, user_soa, io_options);
+            auto save_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - save_start);
+            std::cout << (saved ? "💿 Saved dataset to " : "❌ Failed to save dataset to ") << dataset_dir
+                      << " in " << save_elapsed.count() / 1000000.0 << "ms\n\n";
+        }
+    }
+
+    // AoS строится из колонок одним параллельным транспонированием
+    if (users) *users = soa_to_users(user_soa);
+}
+
+#ifdef BLAZING_HAS_COROUTINES
+/// COROUTINE PIPELINE - источник → фильтры → агрегат, батчами через ограниченные очереди 🌀⚡
+/// Стадии - корутины на пуле: ожидание очереди не занимает поток, генерация
+/// перекрывается со сканом, а в памяти живёт не больше нескольких батчей на очередь.
+struct ColumnBatch {
+    std::vector<int64_t> ids;
+    std::vector<std::string> names;
+    std::vector<uint8_t> ages;
+
+    void reserve(size_t capacity) {
+        ids.reserve(capacity);
+        names.reserve(capacity);
+        ages.reserve(capacity);
+    }
+
+    size_t size() const { return ids.size(); }
+};
+
+/// Группа запущенных стадий: wait() ждёт все и пробрасывает первое исключение.
+/// При ошибке вызываются on_error-хуки (отмена очередей), чтобы остальные стадии доработали.
+class PipelineGroup {
+private:
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t running = 0;
+    std::exception_ptr error;
+    std::vector<std::function<void()>> error_hooks;
+
+public:
+    void on_error(std::function<void()> hook) { error_hooks.push_back(std::move(hook)); }
+
+    void add() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++running;
+    }
+
+    void done(std::exception_ptr stage_error) {
+        if (stage_error) {
+            bool first = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                first = !error;
+                if (first) error = stage_error;
+            }
+            if (first) {
+                for (auto& hook : error_hooks) hook();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) finished.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return running == 0; });
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+/// Корутина-стадия: создаётся приостановленной, start() отдаёт её пулу,
+/// по завершении кадр удаляет себя сам и отмечается в группе.
+class PipelineStage {
+public:
+    struct promise_type {
+        PipelineGroup* group = nullptr;
+        std::exception_ptr error;
+
+        PipelineStage get_return_object() {
+            return PipelineStage(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                PipelineGroup* group = handle.promise().group;
+                std::exception_ptr error = handle.promise().error;
+                handle.destroy();
+                group->done(error);
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    explicit PipelineStage(std::coroutine_handle<promise_type> h) : handle(h) {}
+    PipelineStage(PipelineStage&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+    ~PipelineStage() {
+        if (handle) handle.destroy();
+    }
+
+    void start(ThreadPool& pool, PipelineGroup& group) {
+        handle.promise().group = &group;
+        group.add();
+        pool.submit([h = std::exchange(handle, {})] { h.resume(); });
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/// Ограниченная очередь между стадиями: co_await push() засыпает, пока очередь
+/// полна, co_await pop() - пока пуста; пробуждение - через пул.
+/// Закрывается, когда close() вызвали все producers; cancel() закрывает сразу.
+template <typename T>
+class BoundedQueue {
+private:
+    struct PushWaiter {
+        std::coroutine_handle<> handle;
+        T* value;
+        bool* accepted;
+    };
+    struct PopWaiter {
+        std::coroutine_handle<> handle;
+        std::optional<T>* slot;
+    };
+
+    ThreadPool& pool;
+    const size_t capacity;
+    size_t open_producers;
+    bool closed = false;
+    std::mutex mutex;
+    std::deque<T> items;
+    std::deque<PushWaiter> pushers;
+    std::deque<PopWaiter> poppers;
+
+    void resume_on_pool(std::coroutine_handle<> handle) {
+        pool.submit([handle] { handle.resume(); });
+    }
+
+    void close_locked(std::vector<std::coroutine_handle<>>& wake) {
+        closed = true;
+        for (auto& waiter : poppers) wake.push_back(waiter.handle);
+        for (auto& waiter : pushers) {
+            *waiter.accepted = false;
+            wake.push_back(waiter.handle);
+        }
+        poppers.clear();
+        pushers.clear();
+    }
+
+public:
+    BoundedQueue(ThreadPool& pool, size_t capacity, size_t producers = 1)
+        : pool(pool), capacity(std::max<size_t>(1, capacity)), open_producers(std::max<size_t>(1, producers)) {}
+
+    class PushAwaiter {
+    private:
+        BoundedQueue& queue;
+        T value;
+        bool accepted = true;
+
+    public:
+        PushAwaiter(BoundedQueue& queue, T value) : queue(queue), value(std::move(value)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::coroutine_handle<> wake;
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.closed) {
+                    accepted = false;
+                    return false;
+                }
+                if (!queue.poppers.empty()) {
+                    // Потребитель уже ждёт - отдаём батч прямо ему
+                    PopWaiter waiter = queue.poppers.front();
+                    queue.poppers.pop_front();
+                    *waiter.slot = std::move(value);
+                    wake = waiter.handle;
+                } else if (queue.items.size() < queue.capacity) {
+                    queue.items.push_back(std::move(value));
+                } else {
+                    queue.pushers.push_back({handle, &value, &accepted});
+                    return true;
+                }
+            }
+            if (wake) queue.resume_on_pool(wake);
+            return false;
+        }
+
+        /// false - очередь закрыта, батч отброшен
+        bool await_resume() const noexcept { return accepted; }
+    };
+
+    class PopAwaiter {
+    private:
+        BoundedQueue& queue;
+        std::optional<T> result;
+
+    public:
+        explicit PopAwaiter(BoundedQueue& queue) : queue(queue) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::coroutine_handle<> wake;
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.items.empty()) {
+                    result = std::move(queue.items.front());
+                    queue.items.pop_front();
+                    if (!queue.pushers.empty()) {
+                        // Освободилось место - забираем батч ждущего производителя
+                        PushWaiter waiter = queue.pushers.front();
+                        queue.pushers.pop_front();
+                        queue.items.push_back(std::move(*waiter.value));
+                        wake = waiter.handle;
+                    }
+                } else if (!queue.closed) {
+                    queue.poppers.push_back({handle, &result});
+                    return true;
+                }
+            }
+            if (wake) queue.resume_on_pool(wake);
+            return false;
+        }
+
+        /// nullopt - очередь закрыта и пуста
+        std::optional<T> await_resume() { return std::move(result); }
+    };
+
+    PushAwaiter push(T value) { return PushAwaiter(*this, std::move(value)); }
+    PopAwaiter pop() { return PopAwaiter(*this); }
+
+    void close() {
+        std::vector<std::coroutine_handle<>> wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed || --open_producers > 0) return;
+            close_locked(wake);
+        }
+        for (auto handle : wake) resume_on_pool(handle);
+    }
+
+    void cancel() {
+        std::vector<std::coroutine_handle<>> wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) return;
+            items.clear();
+            close_locked(wake);
+        }
+        for (auto handle : wake) resume_on_pool(handle);
+    }
+};
+
+using BatchQueue = BoundedQueue<ColumnBatch>;
+
+/// Источник: генерирует батчи first_batch, first_batch + stride, ... (несколько генераторов параллельно)
+PipelineStage generate_users_stage(BatchQueue& out, size_t num_users, size_t batch_size,
+                                   size_t first_batch, size_t batch_stride) {
+    for (size_t begin = first_batch * batch_size; begin < num_users; begin += batch_stride * batch_size) {
+        const size_t end = std::min(num_users, begin + batch_size);
+        ColumnBatch batch;
+        batch.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            batch.ids.push_back(static_cast<int64_t>(i));
+            batch.names.push_back("User " + std::to_string(i));
+            batch.ages.push_back(static_cast<uint8_t>(i % 100));
+        }
+        if (!co_await out.push(std::move(batch))) break;
+    }
+    out.close();
+}
+
+/// Источник: колоночные файлы датасета (см. save_dataset) читаются батчами
+PipelineStage read_dataset_stage(BatchQueue& out, std::string dir, size_t batch_size) {
+    std::ifstream ids(dir + "/ids.bin", std::ios::binary);
+    std::ifstream ages(dir + "/ages.bin", std::ios::binary);
+    std::ifstream name_offsets(dir + "/name_offsets.bin", std::ios::binary);
+    std::ifstream names(dir + "/names.bin", std::ios::binary);
+    uint64_t name_end = 0;
+    if (!ids || !ages || !names || !name_offsets.read(reinterpret_cast<char*>(&name_end), sizeof(name_end))) {
+        throw std::runtime_error("cannot open dataset in " + dir);
+    }
+    std::vector<uint64_t> batch_offsets;
+
+    for (;;) {
+        ColumnBatch batch;
+        batch.ids.resize(batch_size);
+        ids.read(reinterpret_cast<char*>(batch.ids.data()), batch_size * sizeof(int64_t));
+        const size_t rows = static_cast<size_t>(ids.gcount()) / sizeof(int64_t);
+        if (rows == 0) break;
+
+        batch.ids.resize(rows);
+        batch.ages.resize(rows);
+        batch.names.resize(rows);
+        if (!ages.read(reinterpret_cast<char*>(batch.ages.data()), rows)) {
+            throw std::runtime_error("truncated ages.bin in " + dir);
+        }
+        batch_offsets.resize(rows);
+        if (!name_offsets.read(reinterpret_cast<char*>(batch_offsets.data()), rows * sizeof(uint64_t))) {
+            throw std::runtime_error("truncated name_offsets.bin in " + dir);
+        }
+        for (size_t i = 0; i < rows; ++i) {
+            if (batch_offsets[i] < name_end) throw std::runtime_error("corrupt name_offsets.bin in " + dir);
+            batch.names[i].resize(batch_offsets[i] - name_end);
+            if (!names.read(batch.names[i].data(), batch.names[i].size())) {
+                throw std::runtime_error("truncated names.bin in " + dir);
+            }
+            name_end = batch_offsets[i];
+        }
+
+        if (!co_await out.push(std::move(batch))) break;
+    }
+    out.close();
+}
+
+/// Фильтр: оставляет строки, для которых keep(id, age) истинно (уплотнение на месте)
+template <typename Predicate>
+PipelineStage filter_stage(BatchQueue& in, BatchQueue& out, Predicate keep) {
+    while (auto batch = co_await in.pop()) {
+        size_t kept = 0;
+        for (size_t i = 0; i < batch->size(); ++i) {
+            if (!keep(batch->ids[i], batch->ages[i])) continue;
+            if (kept != i) {
+                batch->ids[kept] = batch->ids[i];
+                batch->names[kept] = std::move(batch->names[i]);
+                batch->ages[kept] = batch->ages[i];
+            }
+            ++kept;
+        }
+        batch->ids.resize(kept);
+        batch->names.resize(kept);
+        batch->ages.resize(kept);
+
+        if (kept > 0 && !co_await out.push(std::move(*batch))) break;
+    }
+    out.close();
+}
+
+/// Итог конвейера; у каждого агрегатора свой, в конце сливаются
+struct PipelineAggregate {
+    uint64_t rows = 0;
+    uint64_t age_sum = 0;
+    std::array<uint64_t, 256> age_histogram{};
+
+    void merge(const PipelineAggregate& other) {
+        rows += other.rows;
+        age_sum += other.age_sum;
+        for (size_t b = 0; b < age_histogram.size(); ++b) {
+            age_histogram[b] += other.age_histogram[b];
+        }
+    }
+};
+
+PipelineStage aggregate_stage(BatchQueue& in, PipelineAggregate& result) {
+    while (auto batch = co_await in.pop()) {
+        const uint8_t* ages = batch->ages.data();
+        result.rows += batch->size();
+        result.age_sum += sum_u8_prefetch_range(ages, batch->size(), DEFAULT_PREFETCH_DISTANCE);
+        histogram_u8(ages, batch->size(), result.age_histogram.data());
+    }
+}
+
+struct PipelineOptions {
+    std::string source_dir;        // пусто - генерация num_users строк
+    size_t num_users = 0;
+    size_t batch_size = 64 * 1024; // строк в батче
+    size_t queue_capacity = 4;     // батчей в каждой очереди
+    size_t workers = 0;            // копий параллельных стадий; 0 - по размеру пула
+    uint8_t min_age = 0;           // фильтр по возрасту; 0..255 - без стадии фильтра
+    uint8_t max_age = 255;
+};
+
+/// Собирает и запускает конвейер на пуле; false - стадия упала (например, нет файлов)
+bool run_user_pipeline(const PipelineOptions& options, PipelineAggregate& result,
+                       ThreadPool& pool = default_thread_pool()) {
+    const size_t workers = options.workers ? options.workers : pool.size();
+    const size_t batch_size = std::max<size_t>(1, options.batch_size);
+    const bool filtered = options.min_age > 0 || options.max_age < 255;
+    const size_t producers = options.source_dir.empty() ? workers : 1;
+
+    BatchQueue source(pool, options.queue_capacity, producers);
+    BatchQueue filtered_out(pool, options.queue_capacity, workers);
+    BatchQueue& sink_input = filtered ? filtered_out : source;
+    std::vector<PipelineAggregate> partials(workers);
+
+    PipelineGroup group;
+    group.on_error([&] {
+        source.cancel();
+        filtered_out.cancel();
+    });
+
+    if (options.source_dir.empty()) {
+        for (size_t p = 0; p < producers; ++p) {
+            generate_users_stage(source, options.num_users, batch_size, p, producers).start(pool, group);
+        }
+    } else {
+        read_dataset_stage(source, options.source_dir, batch_size).start(pool, group);
+    }
+
+    if (filtered) {
+        const uint8_t lo = options.min_age;
+        const uint8_t hi = options.max_age;
+        for (size_t w = 0; w < workers; ++w) {
+            filter_stage(source, filtered_out, [lo, hi](int64_t, uint8_t age) {
+                return age >= lo && age <= hi;
+            }).start(pool, group);
+        }
+    }
+
+    for (size_t w = 0; w < workers; ++w) {
+        aggregate_stage(sink_input, partials[w]).start(pool, group);
+    }
+
+    try {
+        group.wait();
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Pipeline failed: " << e.what() << "\n";
+        return false;
+    }
+
+    result = PipelineAggregate{};
+    for (const auto& partial : partials) {
+        result.merge(partial);
+    }
+    return true;
+}
+
+/// Верхняя граница батчей в памяти: очереди плюс по батчу в руках у каждой стадии
+size_t pipeline_batch_bound(const PipelineOptions& options, const ThreadPool& pool = default_thread_pool()) {
+    const size_t workers = options.workers ? options.workers : pool.size();
+    const size_t producers = options.source_dir.empty() ? workers : 1;
+    const size_t capacity = std::max<size_t>(1, options.queue_capacity);
+    const bool filtered = options.min_age > 0 || options.max_age < 255;
+    return filtered ? 2 * capacity + producers + 2 * workers : capacity + producers + workers;
+}
+#endif
+
+#ifdef BLAZING_HAS_POSIX_IO
+/// SHARED DATASET - колонки в именованном POSIX shm (/dev/shm) 🧠🤝
+/// Один процесс публикует сегмент, остальные подключаются только на чтение
+/// и работают прямо по его страницам - одна физическая копия на всех.
+struct SharedDatasetHeader {
+    char magic[8];                // "BLZSHM\0\0"
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t rows;
+    uint64_t ids_offset;          // int64_t[rows]
+    uint64_t ages_offset;         // uint8_t[rows]
+    uint64_t name_offsets_offset; // uint64_t[rows + 1] в name_bytes
+    uint64_t name_bytes_offset;
+    uint64_t name_bytes;
+    uint64_t total_size;
+    uint32_t ready;               // 1 - сегмент записан целиком
+    uint32_t reserved;
+};
+
+constexpr char SHARED_DATASET_MAGIC[8] = {'B', 'L', 'Z', 'S', 'H', 'M', 0, 0};
+constexpr uint32_t SHARED_DATASET_VERSION = 1;
+
+class SharedDataset {
+private:
+    void* base = MAP_FAILED;
+    size_t mapped_size = 0;
+    const SharedDatasetHeader* header = nullptr;
+
+    static std::string shm_name(const std::string& name) {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+
+    static uint64_t align_offset(uint64_t offset) {
+        return (offset + 63) & ~uint64_t(63);
+    }
+
+    template <typename T>
+    const T* at(uint64_t offset) const {
+        return reinterpret_cast<const T*>(static_cast<const char*>(base) + offset);
+    }
+
+    /// Массив T[count] по смещению offset выровнен и целиком лежит между заголовком и total_size
+    template <typename T>
+    static bool array_fits(uint64_t offset, uint64_t count, uint64_t total_size) {
+        return offset % alignof(T) == 0 && offset >= sizeof(SharedDatasetHeader) &&
+               offset <= total_size && count <= (total_size - offset) / sizeof(T);
+    }
+
+    /// Колонки и таблица имён не выходят за сегмент: чужой или битый сегмент
+    /// не должен приводить к чтению за пределами отображения
+    bool layout_valid() const {
+        const SharedDatasetHeader& h = *header;
+        if (h.rows >= h.total_size ||
+            !array_fits<int64_t>(h.ids_offset, h.rows, h.total_size) ||
+            !array_fits<uint8_t>(h.ages_offset, h.rows, h.total_size) ||
+            !array_fits<uint64_t>(h.name_offsets_offset, h.rows + 1, h.total_size) ||
+            !array_fits<char>(h.name_bytes_offset, h.name_bytes, h.total_size)) {
+            return false;
+        }
+
+        // Смещения имён неубывающие от 0 до name_bytes - любое name(row) внутри блоба
+        const uint64_t* offsets = at<uint64_t>(h.name_offsets_offset);
+        if (offsets[0] != 0 || offsets[h.rows] != h.name_bytes) return false;
+        for (uint64_t row = 0; row < h.rows; ++row) {
+            if (offsets[row + 1] < offsets[row]) return false;
+        }
+        return true;
+    }
+
+public:
+    SharedDataset() = default;
+    SharedDataset(const SharedDataset&) = delete;
+    SharedDataset& operator=(const SharedDataset&) = delete;
+
+    ~SharedDataset() {
+        if (base != MAP_FAILED) munmap(base, mapped_size);
+    }
+
+    /// Публикует soa под именем name. Старый сегмент с тем же именем
+    /// отвязывается: подключённые к нему процессы дочитают свою копию.
+    static bool create(const std::string& name, const UserSoA& soa) {
+        const std::string path = shm_name(name);
+
+        SharedDatasetHeader h{};
+        std::memcpy(h.magic, SHARED_DATASET_MAGIC, sizeof(h.magic));
+        h.version = SHARED_DATASET_VERSION;
+        h.header_size = sizeof(SharedDatasetHeader);
+        h.rows = soa.size();
+        h.ids_offset = align_offset(sizeof(SharedDatasetHeader));
+        h.ages_offset = align_offset(h.ids_offset + h.rows * sizeof(int64_t));
+        h.name_offsets_offset = align_offset(h.ages_offset + h.rows);
+        h.name_bytes_offset = align_offset(h.name_offsets_offset + (h.rows + 1) * sizeof(uint64_t));
+        for (const auto& user_name : soa.names) {
+            h.name_bytes += user_name.size();
+        }
+        h.total_size = h.name_bytes_offset + h.name_bytes;
+
+        shm_unlink(path.c_str());
+        const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) return false;
+
+        if (ftruncate(fd, static_cast<off_t>(h.total_size)) != 0) {
+            close(fd);
+            shm_unlink(path.c_str());
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, h.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            shm_unlink(path.c_str());
+            return false;
+        }
+
+        char* bytes = static_cast<char*>(mapped);
+        std::memcpy(bytes + h.ids_offset, soa.ids.data(), h.rows * sizeof(int64_t));
+        std::memcpy(bytes + h.ages_offset, soa.ages.data(), h.rows);
+
+        uint64_t* name_offsets = reinterpret_cast<uint64_t*>(bytes + h.name_offsets_offset);
+        uint64_t name_pos = 0;
+        for (size_t i = 0; i < h.rows; ++i) {
+            name_offsets[i] = name_pos;
+            std::memcpy(bytes + h.name_bytes_offset + name_pos, soa.names[i].data(), soa.names[i].size());
+            name_pos += soa.names[i].size();
+        }
+        name_offsets[h.rows] = name_pos;
+
+        // Заголовок последним; ready - release, чтобы читатель видел все колонки
+        std::memcpy(bytes, &h, sizeof(h));
+        __atomic_store_n(&reinterpret_cast<SharedDatasetHeader*>(bytes)->ready, 1u, __ATOMIC_RELEASE);
+
+        munmap(mapped, h.total_size);
+        return true;
+    }
+
+    static bool remove(const std::string& name) {
+        return shm_unlink(shm_name(name).c_str()) == 0;
+    }
+
+    /// Подключение только на чтение с проверкой magic/version/раскладки
+    bool attach(const std::string& name) {
+        const int fd = shm_open(shm_name(name).c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SharedDatasetHeader)) {
+            close(fd);
+            return false;
+        }
+
+        mapped_size = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+
+        header = static_cast<const SharedDatasetHeader*>(base);
+        const bool valid = std::memcmp(header->magic, SHARED_DATASET_MAGIC, sizeof(header->magic)) == 0 &&
+                           header->version == SHARED_DATASET_VERSION &&
+                           header->header_size == sizeof(SharedDatasetHeader) &&
+                           header->total_size <= mapped_size &&
+                           __atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) == 1 &&
+                           layout_valid();
+        if (!valid) {
+            munmap(base, mapped_size);
+            base = MAP_FAILED;
+            header = nullptr;
+        }
+        return valid;
+    }
+
+    size_t rows() const { return header->rows; }
+    const int64_t* ids() const { return at<int64_t>(header->ids_offset); }
+    const uint8_t* ages() const { return at<uint8_t>(header->ages_offset); }
+
+    std::string_view name(size_t row) const {
+        const uint64_t* offsets = at<uint64_t>(header->name_offsets_offset);
+        return std::string_view(at<char>(header->name_bytes_offset) + offsets[row],
+                                offsets[row + 1] - offsets[row]);
+    }
+
+    DatasetView view() const {
+        return DatasetView{ids(), ages(), rows()};
+    }
+};
+#endif
+
+/// QUERY DAEMON - датасет живёт в памяти, запросы по Unix-сокету 🛰️⚡
+/// Запрос - 24 байта, ответ - 16-байтовый заголовок и count значений uint64
+/// (порядок байт хоста). Клиент может слать запросы пачкой, не дожидаясь ответов.
+enum class QueryOp : uint8_t {
+    Count = 1,         // -> [rows]
+    SumAges = 2,       // -> [sum]
+    AvgAge = 3,        // -> [биты double]
+    CountAgeRange = 4, // arg0 <= age <= arg1 -> [count]
+    AgeHistogram = 5,  // -> [256 счётчиков]
+    Shutdown = 255,
+};
+
+enum QueryStatus : uint8_t {
+    QUERY_OK = 0,
+    QUERY_BAD_REQUEST = 1,
+    QUERY_WORKER_FAILED = 2, // координатор не дождался ответа воркера
+    QUERY_PARTIAL = 3,       // бюджет вышел - ответ по префиксу, см. coverage_ppm
+};
+
+/// Покрытие в миллионных долях строк: 1000000 - весь датасет
+constexpr uint32_t FULL_COVERAGE_PPM = 1000000;
+
+struct QueryRequest {
+    uint32_t request_id;
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t budget_ms; // 0 - без ограничения (или QUERY_BUDGET_MS сервера)
+    int64_t arg0;
+    int64_t arg1;
+};
+static_assert(sizeof(QueryRequest) == 24, "QueryRequest wire format");
+
+struct QueryResponseHeader {
+    uint32_t request_id;
+    uint8_t status;
+    uint8_t reserved[3];
+    uint32_t count;
+    uint32_t coverage_ppm;
+};
+static_assert(sizeof(QueryResponseHeader) == 16, "QueryResponseHeader wire format");
+
+struct QueryResult {
+    uint8_t status = QUERY_OK;
+    std::vector<uint64_t> values;
+    uint32_t coverage_ppm = FULL_COVERAGE_PPM;
+};
+
+inline QueryRequest make_query(uint32_t request_id, QueryOp op, int64_t arg0 = 0, int64_t arg1 = 0,
+                               uint16_t budget_ms = 0) {
+    QueryRequest request{};
+    request.request_id = request_id;
+    request.op = static_cast<uint8_t>(op);
+    request.budget_ms = budget_ms;
+    request.arg0 = arg0;
+    request.arg1 = arg1;
+    return request;
+}
+
+/// QUERY_BUDGET_MS: бюджет скана на запрос (клиент) или на пачку (сервер), 0 - без ограничения
+inline uint16_t query_budget_from_env() {
+    const char* env_budget = std::getenv("QUERY_BUDGET_MS");
+    return env_budget ? static_cast<uint16_t>(std::min<unsigned long long>(std::stoull(env_budget), 65535)) : 0;
+}
+
+inline uint8_t clamp_age_arg(int64_t value) {
+    return static_cast<uint8_t>(std::clamp<int64_t>(value, 0, 255));
+}
+
+/// Диапазон [arg0, arg1] не пересекает [0, 255] - ответ 0 без скана; иначе его можно обрезать
+inline bool age_range_empty(const QueryRequest& request) {
+    return request.arg0 > request.arg1 || request.arg1 < 0 || request.arg0 > 255;
+}
+
+QueryResult execute_query(const DatasetView& data, const QueryRequest& request) {
+    switch (static_cast<QueryOp>(request.op)) {
+        case QueryOp::Count:
+            return {QUERY_OK, {data.rows}};
+        case QueryOp::SumAges:
+            return {QUERY_OK, {sum_u8_prefetch_parallel(data.ages, data.rows)}};
+        case QueryOp::AvgAge: {
+            const double avg = data.rows ? static_cast<double>(sum_u8_prefetch_parallel(data.ages, data.rows)) / data.rows : 0.0;
+            uint64_t bits;
+            std::memcpy(&bits, &avg, sizeof(bits));
+            return {QUERY_OK, {bits}};
+        }
+        case QueryOp::CountAgeRange:
+            if (age_range_empty(request)) return {QUERY_OK, {0}};
+            return {QUERY_OK, {count_u8_in_range_parallel(data.ages, data.rows, clamp_age_arg(request.arg0),
+                                                          clamp_age_arg(request.arg1))}};
+        case QueryOp::AgeHistogram: {
+            const auto hist = histogram_u8_parallel(data.ages, data.rows);
+            return {QUERY_OK, std::vector<uint64_t>(hist.begin(), hist.end())};
+        }
+        case QueryOp::Shutdown:
+            return {QUERY_OK, {}};
+    }
+    return {QUERY_BAD_REQUEST, {}};
+}
+
+/// SHARED SCAN - все запросы пачки за один проход по колонке 🔗⚡
+/// Колонка идёт блоками, помещающимися в L2; каждый блок прогоняется через все
+/// ядра пачки, пока он горячий. Из DRAM колонка читается ровно один раз.
+constexpr size_t SHARED_SCAN_BLOCK = 64 * 1024;
+
+/// С этого числа диапазонов дешевле одна гистограмма, чем счётчик на каждый
+constexpr size_t SHARED_SCAN_HISTOGRAM_RANGES = 8;
+
+struct SharedScanPlan {
+    bool need_sum = false;
+    bool need_histogram = false;
+    std::vector<std::pair<uint8_t, uint8_t>> ranges; // [lo, hi] включительно
+};
+
+struct SharedScanResult {
+    uint64_t sum = 0;
+    std::array<uint64_t, 256> histogram{};
+    std::vector<uint64_t> range_counts; // по plan.ranges
+};
+
+/// Один блок в сырые счётчики; в режиме гистограммы сумма и диапазоны выводятся в finish
+inline void shared_scan_block(const uint8_t* ptr, size_t len, const SharedScanPlan& plan, SharedScanResult& result) {
+    if (plan.need_histogram) {
+        histogram_u8(ptr, len, result.histogram.data());
+        return;
+    }
+    if (plan.need_sum) {
+        result.sum += sum_u8_prefetch_range(ptr, len, DEFAULT_PREFETCH_DISTANCE);
+    }
+    for (size_t r = 0; r < plan.ranges.size(); ++r) {
+        result.range_counts[r] += count_u8_in_range(ptr, len, plan.ranges[r].first, plan.ranges[r].second);
+    }
+}
+
+inline void finish_shared_scan(const SharedScanPlan& plan, SharedScanResult& result) {
+    if (!plan.need_histogram) return;
+    for (int b = 0; b < 256; ++b) {
+        result.sum += uint64_t(b) * result.histogram[b];
+    }
+    for (size_t r = 0; r < plan.ranges.size(); ++r) {
+        for (int b = plan.ranges[r].first; b <= plan.ranges[r].second; ++b) {
+            result.range_counts[r] += result.histogram[b];
+        }
+    }
+}
+
+/// Блоки раздаются воркерам по одному; control может прервать скан между блоками
+PartialScan<SharedScanResult> shared_scan_parallel(const uint8_t* ptr, size_t len, const SharedScanPlan& plan,
+                                                   const ScanControl& control = {}) {
+    SharedScanResult identity;
+    identity.range_counts.assign(plan.ranges.size(), 0);
+
+    auto scan = scan_blocks_budgeted(len, identity, [ptr, &plan](SharedScanResult& acc, size_t begin, size_t end) {
+        shared_scan_block(ptr + begin, end - begin, plan, acc);
+    }, [](SharedScanResult total, const SharedScanResult& part) {
+        total.sum += part.sum;
+        for (int b = 0; b < 256; ++b) {
+            total.histogram[b] += part.histogram[b];
+        }
+        for (size_t r = 0; r < total.range_counts.size(); ++r) {
+            total.range_counts[r] += part.range_counts[r];
+        }
+        return total;
+    }, control, SHARED_SCAN_BLOCK);
+
+    finish_shared_scan(plan, scan.value);
+    return scan;
+}
+
+/// Пачка конкурентных запросов за один проход по ages: одинаковые (op, arg0, arg1)
+/// считаются один раз, остальные собираются в общий план скана. Скан останавливается
+/// по control или по самому раннему budget_ms в пачке - тогда ответы QUERY_PARTIAL.
+std::vector<QueryResult> execute_query_batch(const DatasetView& data, const std::vector<QueryRequest>& batch,
+                                             ScanControl control = {}) {
+    std::vector<QueryResult> results(batch.size());
+    SharedScanPlan plan;
+    std::map<std::pair<uint8_t, uint8_t>, size_t> range_slots;
+
+    const auto batch_start = steady_clock::now();
+    for (const auto& request : batch) {
+        if (request.budget_ms > 0) {
+            control.deadline = std::min(control.deadline, batch_start + milliseconds(request.budget_ms));
+        }
+
+        switch (static_cast<QueryOp>(request.op)) {
+            case QueryOp::SumAges:
+            case QueryOp::AvgAge:
+                plan.need_sum = true;
+                break;
+            case QueryOp::CountAgeRange:
+                if (!age_range_empty(request)) {
+                    const auto range = std::make_pair(clamp_age_arg(request.arg0), clamp_age_arg(request.arg1));
+                    if (range_slots.emplace(range, plan.ranges.size()).second) plan.ranges.push_back(range);
+                }
+                break;
+            case QueryOp::AgeHistogram:
+                plan.need_histogram = true;
+                break;
+            default:
+                break;
+        }
+    }
+    if (plan.ranges.size() >= SHARED_SCAN_HISTOGRAM_RANGES) plan.need_histogram = true;
+
+    PartialScan<SharedScanResult> partial{SharedScanResult{}, data.rows, data.rows};
+    if (plan.need_sum || plan.need_histogram || !plan.ranges.empty()) {
+        partial = shared_scan_parallel(data.ages, data.rows, plan, control);
+    }
+    const SharedScanResult& scan = partial.value;
+    const uint8_t scan_status = partial.complete() ? QUERY_OK : QUERY_PARTIAL;
+    const uint32_t scan_coverage = partial.complete()
+        ? FULL_COVERAGE_PPM
+        : static_cast<uint32_t>(partial.coverage() * FULL_COVERAGE_PPM);
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const QueryRequest& request = batch[i];
+        switch (static_cast<QueryOp>(request.op)) {
+            case QueryOp::SumAges:
+                results[i] = {scan_status, {scan.sum}, scan_coverage};
+                break;
+            case QueryOp::AvgAge: {
+                // Частичное среднее - по просканированному префиксу
+                const double avg = partial.rows_scanned ? static_cast<double>(scan.sum) / partial.rows_scanned : 0.0;
+                uint64_t bits;
+                std::memcpy(&bits, &avg, sizeof(bits));
+                results[i] = {scan_status, {bits}, scan_coverage};
+                break;
+            }
+            case QueryOp::CountAgeRange:
+                if (age_range_empty(request)) {
+                    results[i] = {QUERY_OK, {0}};
+                } else {
+                    const auto range = std::make_pair(clamp_age_arg(request.arg0), clamp_age_arg(request.arg1));
+                    results[i] = {scan_status, {scan.range_counts[range_slots[range]]}, scan_coverage};
+                }
+                break;
+            case QueryOp::AgeHistogram:
+                results[i] = {scan_status, std::vector<uint64_t>(scan.histogram.begin(), scan.histogram.end()),
+                              scan_coverage};
+                break;
+            default:
+                // Count, Shutdown и неизвестные - без скана
+                results[i] = execute_query(data, request);
+                break;
+        }
+    }
+
+    return results;
+}
+
+#ifdef BLAZING_HAS_POSIX_IO
+inline bool set_nonblocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+inline bool make_unix_address(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/// Адрес сокета: "tcp:host:port" - TCP, "unix:path" или просто путь - Unix-сокет
+struct SocketEndpoint {
+    bool tcp = false;
+    std::string path; // Unix
+    std::string host; // TCP
+    std::string port;
+};
+
+inline SocketEndpoint parse_endpoint(const std::string& text) {
+    SocketEndpoint endpoint;
+    if (text.compare(0, 4, "tcp:") == 0) {
+        const std::string rest = text.substr(4);
+        const size_t colon = rest.rfind(':');
+        endpoint.tcp = true;
+        endpoint.host = colon == std::string::npos ? "127.0.0.1" : rest.substr(0, colon);
+        endpoint.port = colon == std::string::npos ? rest : rest.substr(colon + 1);
+    } else {
+        endpoint.path = text.compare(0, 5, "unix:") == 0 ? text.substr(5) : text;
+    }
+    return endpoint;
+}
+
+/// Слушающий сокет (неблокирующий) или -1
+inline int listen_endpoint(const SocketEndpoint& endpoint) {
+    if (!endpoint.tcp) {
+        sockaddr_un addr;
+        if (!make_unix_address(endpoint.path, addr)) return -1;
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(endpoint.path.c_str());
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(fd, 128) != 0 || !set_nonblocking(fd)) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* info = nullptr;
+    if (getaddrinfo(endpoint.host.empty() ? nullptr : endpoint.host.c_str(), endpoint.port.c_str(), &hints, &info) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 128) != 0 || !set_nonblocking(fd)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(info);
+    return fd;
+}
+
+/// Блокирующее соединение или -1; для TCP выключаем Нейгла - запросы мелкие
+inline int connect_endpoint(const SocketEndpoint& endpoint) {
+    if (!endpoint.tcp) {
+        sockaddr_un addr;
+        if (!make_unix_address(endpoint.path, addr)) return -1;
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* info = nullptr;
+    if (getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &info) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    freeaddrinfo(info);
+    return fd;
+}
+
+inline bool write_all(int fd, const void* data, size_t len) {
+    const char* ptr = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, ptr, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+inline bool read_all(int fd, void* data, size_t len) {
+    char* ptr = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = read(fd, ptr, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+struct QueryConnection {
+    int fd;
+    std::vector<char> in;
+    std::vector<char> out;
+    size_t out_pos = 0;
+    bool closed = false;
+};
+
+/// Однопоточный цикл poll(): все запросы, пришедшие за итерацию со всех
+/// соединений, исполняются одной пачкой; сами ядра параллельны.
+int run_query_server(const std::string& socket_path, const DatasetView& data) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const SocketEndpoint endpoint = parse_endpoint(socket_path);
+    const int listen_fd = listen_endpoint(endpoint);
+    if (listen_fd < 0) {
+        std::cerr << "❌ Cannot listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    const uint16_t server_budget_ms = query_budget_from_env();
+    std::cout << "🛰️ Serving " << data.rows << " users on " << socket_path << "\n";
+
+    std::vector<QueryConnection> connections;
+    std::vector<pollfd> fds;
+    std::vector<QueryRequest> batch;
+    std::vector<size_t> owners;
+    bool running = true;
+
+    while (running) {
+        fds.clear();
+        fds.push_back(pollfd{listen_fd, POLLIN, 0});
+        for (const auto& c : connections) {
+            const short events = POLLIN | (c.out_pos < c.out.size() ? POLLOUT : 0);
+            fds.push_back(pollfd{c.fd, events, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // Читаем всё доступное и собираем полные запросы в пачку
+        batch.clear();
+        owners.clear();
+        for (size_t i = 0; i < connections.size(); ++i) {
+            QueryConnection& c = connections[i];
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            char chunk[64 * 1024];
+            for (;;) {
+                ssize_t n = read(c.fd, chunk, sizeof(chunk));
+                if (n > 0) {
+                    c.in.insert(c.in.end(), chunk, chunk + n);
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c.closed = true;
+                break;
+            }
+
+            const size_t complete = c.in.size() / sizeof(QueryRequest);
+            for (size_t r = 0; r < complete; ++r) {
+                QueryRequest request;
+                std::memcpy(&request, c.in.data() + r * sizeof(QueryRequest), sizeof(request));
+                batch.push_back(request);
+                owners.push_back(i);
+            }
+            c.in.erase(c.in.begin(), c.in.begin() + complete * sizeof(QueryRequest));
+        }
+
+        // Сервер может ограничить каждую пачку своим бюджетом, чтобы медленный запрос не держал остальных
+        const auto results = execute_query_batch(
+            data, batch, server_budget_ms ? ScanControl::with_budget(milliseconds(server_budget_ms)) : ScanControl{});
+        for (size_t k = 0; k < batch.size(); ++k) {
+            if (batch[k].op == static_cast<uint8_t>(QueryOp::Shutdown)) running = false;
+
+            QueryResponseHeader header{};
+            header.request_id = batch[k].request_id;
+            header.status = results[k].status;
+            header.count = static_cast<uint32_t>(results[k].values.size());
+            header.coverage_ppm = results[k].coverage_ppm;
+
+            auto& out = connections[owners[k]].out;
+            const char* header_bytes = reinterpret_cast<const char*>(&header);
+            const char* value_bytes = reinterpret_cast<const char*>(results[k].values.data());
+            out.insert(out.end(), header_bytes, header_bytes + sizeof(header));
+            out.insert(out.end(), value_bytes, value_bytes + results[k].values.size() * sizeof(uint64_t));
+        }
+
+        // Отправляем сколько примет сокет, остальное - на следующей итерации
+        for (auto& c : connections) {
+            while (c.out_pos < c.out.size()) {
+                ssize_t n = send(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, 0);
+                if (n > 0) {
+                    c.out_pos += n;
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) c.closed = true;
+                break;
+            }
+            if (c.out_pos == c.out.size()) {
+                c.out.clear();
+                c.out_pos = 0;
+            }
+        }
+
+        connections.erase(std::remove_if(connections.begin(), connections.end(), [](const QueryConnection& c) {
+            if (c.closed) close(c.fd);
+            return c.closed;
+        }), connections.end());
+
+        if (fds[0].revents & POLLIN) {
+            for (int fd; (fd = accept(listen_fd, nullptr, nullptr)) >= 0;) {
+                set_nonblocking(fd);
+                if (endpoint.tcp) {
+                    const int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                }
+                connections.push_back(QueryConnection{fd, {}, {}, 0, false});
+            }
+        }
+    }
+
+    // Дописываем хвосты ответов (в том числе на Shutdown) и закрываемся
+    for (auto& c : connections) {
+        const int flags = fcntl(c.fd, F_GETFL, 0);
+        fcntl(c.fd, F_SETFL, flags & ~O_NONBLOCK);
+        write_all(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos);
+        close(c.fd);
+    }
+    close(listen_fd);
+    if (!endpoint.tcp) unlink(endpoint.path.c_str());
+
+    std::cout << "🛰️ Server stopped\n";
+    return 0;
+}
+
+inline bool parse_query_op(const std::string& op_name, QueryOp& op) {
+    const std::pair<const char*, QueryOp> ops[] = {
+        {"count", QueryOp::Count}, {"sum", QueryOp::SumAges}, {"avg", QueryOp::AvgAge},
+        {"range", QueryOp::CountAgeRange}, {"histogram", QueryOp::AgeHistogram},
+        {"shutdown", QueryOp::Shutdown},
+    };
+    const auto op_it = std::find_if(std::begin(ops), std::end(ops),
+                                    [&](const auto& entry) { return op_name == entry.first; });
+    if (op_it == std::end(ops)) {
+        std::cerr << "❌ Unknown query: " << op_name << "\n";
+        return false;
+    }
+    op = op_it->second;
+    return true;
+}
+
+inline void print_query_values(const std::string& op_name, QueryOp op, const std::vector<uint64_t>& values) {
+    std::cout << op_name << ":";
+    if (op == QueryOp::AvgAge && !values.empty()) {
+        double avg;
+        std::memcpy(&avg, &values[0], sizeof(avg));
+        std::cout << " " << avg;
+    } else {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (op == QueryOp::AgeHistogram && values[i] == 0) continue;
+            if (op == QueryOp::AgeHistogram) std::cout << " " << i << "=";
+            else std::cout << " ";
+            std::cout << values[i];
+        }
+    }
+    std::cout << "\n";
+}
+
+/// Клиент: query <socket> <count|sum|avg|range|histogram|shutdown> [arg0 arg1].
+/// QUERY_REPEAT=N шлёт N копий конвейером и меряет среднюю задержку.
+int run_query_client(const std::string& socket_path, const std::string& op_name, int64_t arg0, int64_t arg1) {
+    QueryOp op;
+    if (!parse_query_op(op_name, op)) return 1;
+
+    size_t repeat = 1;
+    if (const char* env_repeat = std::getenv("QUERY_REPEAT")) {
+        repeat = std::max<size_t>(1, std::stoull(env_repeat));
+    }
+    const uint16_t budget_ms = query_budget_from_env();
+
+    const int fd = connect_endpoint(parse_endpoint(socket_path));
+    if (fd < 0) {
+        std::cerr << "❌ Cannot connect to " << socket_path << "\n";
+        return 1;
+    }
+
+    std::vector<QueryRequest> requests(repeat);
+    for (size_t i = 0; i < repeat; ++i) {
+        requests[i] = make_query(static_cast<uint32_t>(i), op, arg0, arg1, budget_ms);
+    }
+
+    auto start = high_resolution_clock::now();
+    bool ok = write_all(fd, requests.data(), requests.size() * sizeof(QueryRequest));
+
+    std::vector<uint64_t> values;
+    QueryResponseHeader header{};
+    for (size_t i = 0; ok && i < repeat; ++i) {
+        ok = read_all(fd, &header, sizeof(header));
+        values.resize(header.count);
+        ok = ok && read_all(fd, values.data(), values.size() * sizeof(uint64_t));
+    }
+    auto elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - start);
+    close(fd);
+
+    if (!ok || (header.status != QUERY_OK && header.status != QUERY_PARTIAL)) {
+        std::cerr << "❌ Query failed\n";
+        return 1;
+    }
+
+    print_query_values(op_name, op, values);
+    if (header.status == QUERY_PARTIAL) {
+        std::cout << "⏱️ partial: " << header.coverage_ppm / 10000.0 << "% of rows scanned\n";
+    }
+    std::cout << repeat << " queries, " << elapsed.count() / 1000.0 / repeat << "µs per query\n";
+    return 0;
+}
+
+/// SCATTER-GATHER - датасет разбит по диапазонам id между воркерами (serve с SHARD=k/n),
+/// координатор рассылает запрос всем и сливает частичные агрегаты 🕸️⚡
+/// Воркеры - обычные демоны запросов: Unix-сокеты на одной машине или TCP между узлами.
+QueryResult scatter_gather_query(const std::vector<std::string>& workers, const QueryRequest& request) {
+    const QueryOp op = static_cast<QueryOp>(request.op);
+
+    // Среднее не складывается - у шардов спрашиваем сумму и число строк
+    std::vector<QueryRequest> shard_requests;
+    if (op == QueryOp::AvgAge) {
+        shard_requests.push_back(make_query(0, QueryOp::SumAges, 0, 0, request.budget_ms));
+        shard_requests.push_back(make_query(1, QueryOp::Count));
+    } else {
+        shard_requests.push_back(request);
+        shard_requests.back().request_id = 0;
+    }
+
+    // Scatter: запросы уходят всем воркерам до первого чтения - шарды считают одновременно
+    std::vector<int> fds;
+    uint8_t status = QUERY_OK;
+    for (const auto& worker : workers) {
+        const int fd = connect_endpoint(parse_endpoint(worker));
+        if (fd < 0) {
+            status = QUERY_WORKER_FAILED;
+            break;
+        }
+        fds.push_back(fd);
+        if (!write_all(fd, shard_requests.data(), shard_requests.size() * sizeof(QueryRequest))) {
+            status = QUERY_WORKER_FAILED;
+            break;
+        }
+    }
+
+    // Gather: ответы с одинаковым request_id складываются поэлементно.
+    // Частичный ответ шарда даёт частичный итог с минимальным покрытием среди шардов.
+    std::vector<std::vector<uint64_t>> totals(shard_requests.size());
+    std::vector<uint64_t> values;
+    uint32_t coverage_ppm = FULL_COVERAGE_PPM;
+    for (int fd : fds) {
+        for (size_t r = 0; status == QUERY_OK && r < shard_requests.size(); ++r) {
+            QueryResponseHeader header{};
+            if (!read_all(fd, &header, sizeof(header)) || header.request_id >= totals.size()) {
+                status = QUERY_WORKER_FAILED;
+                break;
+            }
+            values.resize(header.count);
+            if (!read_all(fd, values.data(), values.size() * sizeof(uint64_t))) {
+                status = QUERY_WORKER_FAILED;
+                break;
+            }
+            if (header.status != QUERY_OK && header.status != QUERY_PARTIAL) {
+                status = header.status;
+                break;
+            }
+            if (header.status == QUERY_PARTIAL) {
+                coverage_ppm = std::min(coverage_ppm, header.coverage_ppm);
+                // Для среднего частичная сумма шарда экстраполируется на весь шард
+                if (op == QueryOp::AvgAge && header.request_id == 0 && header.coverage_ppm > 0 && !values.empty()) {
+                    values[0] = static_cast<uint64_t>(static_cast<double>(values[0]) * FULL_COVERAGE_PPM / header.coverage_ppm);
+                }
+            }
+
+            auto& total = totals[header.request_id];
+            if (total.size() < values.size()) total.resize(values.size(), 0);
+            for (size_t i = 0; i < values.size(); ++i) {
+                total[i] += values[i];
+            }
+        }
+        close(fd);
+    }
+
+    if (status != QUERY_OK) return {status, {}};
+    status = coverage_ppm < FULL_COVERAGE_PPM ? QUERY_PARTIAL : QUERY_OK;
+
+    if (op == QueryOp::AvgAge) {
+        const uint64_t sum = totals[0].empty() ? 0 : totals[0][0];
+        const uint64_t rows = totals[1].empty() ? 0 : totals[1][0];
+        const double avg = rows ? static_cast<double>(sum) / rows : 0.0;
+        uint64_t bits;
+        std::memcpy(&bits, &avg, sizeof(bits));
+        return {status, {bits}, coverage_ppm};
     }
-    
-    return total_sum;
+    return {status, std::move(totals[0]), coverage_ppm};
 }
 
-/// LUDICROUS SPEED VERSION - параллельный GODLIKE! 🚀⚡🚀
-uint64_t sum_u8_ludicrous_parallel(const std::vector<uint8_t>& data) {
-    const size_t num_threads = std::thread::hardware_concurrency();
-    const size_t chunk_size = data.size() / num_threads;
-    
-    std::vector<std::future<uint64_t>> futures;
-    
-    for (size_t t = 0; t < num_threads; ++t) {
-        size_t start = t * chunk_size;
-        size_t end = (t == num_threads - 1) ? data.size() : (t + 1) * chunk_size;
-        
-        futures.push_back(std::async(std::launch::async, [&data, start, end]() {
-            std::vector<uint8_t> chunk(data.begin() + start, data.begin() + end);
-            return sum_u8_godlike(chunk);
-        }));
+/// Координатор: gather <worker,worker,...> <op> [arg0 arg1]
+int run_gather_client(const std::string& worker_list, const std::string& op_name, int64_t arg0, int64_t arg1) {
+    QueryOp op;
+    if (!parse_query_op(op_name, op)) return 1;
+
+    std::vector<std::string> workers;
+    for (size_t begin = 0; begin <= worker_list.size();) {
+        size_t end = worker_list.find(',', begin);
+        if (end == std::string::npos) end = worker_list.size();
+        if (end > begin) workers.push_back(worker_list.substr(begin, end - begin));
+        begin = end + 1;
     }
-    
-    uint64_t total_sum = 0;
-    for (auto& future : futures) {
-        total_sum += future.get();
+    if (workers.empty()) {
+        std::cerr << "❌ No workers given\n";
+        return 1;
     }
-    
-    return total_sum;
-}
 
-/// STL PARALLEL VERSION - std::execution! 🔥📚
-uint64_t sum_u8_stl_parallel(const std::vector<uint8_t>& data) {
-    // C++17 parallel algorithms
-    return std::transform_reduce(
-        std::execution::par_unseq,
-        data.begin(), data.end(),
-        0ULL,
-        std::plus<uint64_t>{},
-        [](uint8_t val) { return static_cast<uint64_t>(val); }
-    );
+    auto start = high_resolution_clock::now();
+    const QueryResult result = scatter_gather_query(workers, make_query(0, op, arg0, arg1, query_budget_from_env()));
+    auto elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - start);
+
+    if (result.status != QUERY_OK && result.status != QUERY_PARTIAL) {
+        std::cerr << "❌ Query failed (status " << int(result.status) << ")\n";
+        return 1;
+    }
+
+    print_query_values(op_name, op, result.values);
+    if (result.status == QUERY_PARTIAL) {
+        std::cout << "⏱️ partial: at least " << result.coverage_ppm / 10000.0 << "% of each shard scanned\n";
+    }
+    std::cout << workers.size() << " workers, " << elapsed.count() / 1000.0 << "µs\n";
+    return 0;
 }
 
-/// BLAZING FAST I/O - оптимизированный вывод! 🚀💾
-class BlazingWriter {
-private:
-    std::ofstream file;
-    std::vector<char> buffer;
-    size_t buffer_pos = 0;
-    static constexpr size_t BUFFER_SIZE = 64 * 1024; // 64KB
-    
-public:
-    BlazingWriter(const std::string& filename) 
-        : file(filename, std::ios::binary), buffer(BUFFER_SIZE) {
-        file.rdbuf()->pubsetbuf(nullptr, 0); // Unbuffered for maximum control
+/// Режимы процесса:
+///   serve <socket>        - демон запросов (SHM_DATASET=name - поверх shm сегмента,
+///                           SHARD=k/n - только k-й из n диапазонов id)
+///   query <socket> <op>   - клиент
+///   gather <w1,w2,..> <op> - координатор: запрос ко всем шардам и слияние
+///   shm-create <name>     - собрать датасет и опубликовать в /dev/shm
+///   shm-drop <name>       - удалить сегмент
+/// Возвращает -1, если режим не задан - тогда выполняется бенчмарк.
+int run_mode(int argc, char** argv) {
+    if (argc < 3) return -1;
+    const std::string_view mode(argv[1]);
+
+    if (mode == "query") {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " query <socket> <op> [arg0 arg1]\n";
+            return 1;
+        }
+        return run_query_client(argv[2], argv[3], argc > 4 ? std::stoll(argv[4]) : 0,
+                                argc > 5 ? std::stoll(argv[5]) : 0);
     }
-    
-    void write_line(const std::string& data) {
-        const char* str = data.c_str();
-        size_t len = data.length();
-        
-        if (buffer_pos + len + 1 > BUFFER_SIZE) {
-            flush();
+
+    if (mode == "gather") {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " gather <worker,worker,...> <op> [arg0 arg1]\n";
+            return 1;
         }
-        
-        std::memcpy(&buffer[buffer_pos], str, len);
-        buffer_pos += len;
-        buffer[buffer_pos++] = '\n';
+        return run_gather_client(argv[2], argv[3], argc > 4 ? std::stoll(argv[4]) : 0,
+                                 argc > 5 ? std::stoll(argv[5]) : 0);
     }
-    
-    void flush() {
-        if (buffer_pos > 0) {
-            file.write(buffer.data(), buffer_pos);
-            buffer_pos = 0;
+
+    if (mode == "shm-drop") {
+        return SharedDataset::remove(argv[2]) ? 0 : 1;
+    }
+
+    if (mode != "serve" && mode != "shm-create") return -1;
+
+    // SHARD=k/n: воркер scatter-gather держит только свой диапазон id
+    std::optional<IdShard> shard;
+    if (const char* env_shard = std::getenv("SHARD")) {
+        shard = IdShard::parse(env_shard);
+        if (!shard) {
+            std::cerr << "❌ SHARD must be k/n with k < n\n";
+            return 1;
         }
     }
-    
-    ~BlazingWriter() {
-        flush();
+
+    if (const char* shm_dataset = std::getenv("SHM_DATASET"); shm_dataset && mode == "serve") {
+        SharedDataset shared;
+        if (!shared.attach(shm_dataset)) {
+            std::cerr << "❌ Cannot attach shared dataset " << shm_dataset << "\n";
+            return 1;
+        }
+        std::cout << "🤝 Attached shared dataset " << shm_dataset << " (" << shared.rows() << " users)\n";
+        if (!shard) return run_query_server(argv[2], shared.view());
+
+        UserSoA shard_storage;
+        const DatasetView view = shard_view(shared.view(), *shard, shard_storage);
+        std::cout << "🕸️ Shard " << shard->shard << "/" << shard->shards << ": " << view.rows << " users"
+                  << (shard_storage.size() ? " (copied)" : "") << "\n";
+        return run_query_server(argv[2], view);
     }
-};
 
-/// ULTRA FAST печать без аллокаций! ⚡📊
-void print_results_ultra_fast(const std::string& name, uint64_t avg_age, 
-                             uint64_t elapsed_nanos, uint64_t baseline_nanos) {
-    char buffer[256];
-    int pos = 0;
-    
-    // Копируем название
-    std::memcpy(buffer + pos, name.c_str(), name.length());
-    pos += name.length();
-    
-    // Добавляем ": "
-    buffer[pos++] = ':';
-    buffer[pos++] = ' ';
-    
-    // Добавляем возраст
-    pos += sprintf(buffer + pos, "%llu", avg_age);
-    
-    // Добавляем " - "
-    buffer[pos++] = ' ';
-    buffer[pos++] = '-';
-    buffer[pos++] = ' ';
-    
-    // Добавляем время
-    if (elapsed_nanos >= 1000000000) {
-        pos += sprintf(buffer + pos, "%llus", elapsed_nanos / 1000000000);
-    } else if (elapsed_nanos >= 1000000) {
-        pos += sprintf(buffer + pos, "%llums", elapsed_nanos / 1000000);
-    } else if (elapsed_nanos >= 1000) {
-        pos += sprintf(buffer + pos, "%lluus", elapsed_nanos / 1000);
-    } else {
-        pos += sprintf(buffer + pos, "%lluns", elapsed_nanos);
+    size_t num_users = 100000000;
+    if (const char* env_users = std::getenv("NUM_USERS")) {
+        num_users = std::stoull(env_users);
     }
-    
-    // Добавляем ускорение
-    uint64_t speedup = baseline_nanos / std::max(1ULL, elapsed_nanos);
-    if (speedup > 1) {
-        pos += sprintf(buffer + pos, " (%llux faster)", speedup);
+
+    UserSoA user_soa;
+    auto load_start = high_resolution_clock::now();
+    prepare_dataset(user_soa, nullptr, num_users, shard ? &*shard : nullptr);
+    auto load_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - load_start);
+    std::cout << "Dataset ready in " << load_elapsed.count() / 1000000.0 << "ms\n";
+    if (shard) {
+        std::cout << "🕸️ Shard " << shard->shard << "/" << shard->shards << ": " << user_soa.size() << " users\n";
     }
-    
-    // Один системный вызов
-    std::cout.write(buffer, pos);
-    std::cout.put('\n');
+
+    if (mode == "shm-create") {
+        const bool created = SharedDataset::create(argv[2], user_soa);
+        std::cout << (created ? "🤝 Published shared dataset " : "❌ Failed to publish shared dataset ")
+                  << argv[2] << "\n";
+        return created ? 0 : 1;
+    }
+
+    return run_query_server(argv[2], DatasetView::of(user_soa));
 }
+#endif
+
+int main(int argc, char** argv) {
+    #ifdef BLAZING_HAS_POSIX_IO
+    if (const int mode_status = run_mode(argc, argv); mode_status >= 0) {
+        return mode_status;
+    }
+    #endif
 
-int main() {
     std::cout << "🚀⚡ C++ BLAZING FAST VERSION ⚡🚀\n\n";
     
     // Читаем количество пользователей из переменной окружения
@@ -340,6 +6419,34 @@ int main() {
         num_users = std::stoull(env_users);
     }
     
+    #ifdef BLAZING_HAS_COROUTINES
+    // PIPELINE=1: источник (генерация или DATASET_DIR) → агрегат потоково, батчами;
+    // PIPELINE=only - только конвейер, полный датасет в памяти не строится
+    if (const char* env_pipeline = std::getenv("PIPELINE")) {
+        PipelineOptions pipeline_options;
+        pipeline_options.num_users = num_users;
+        if (const char* dir = std::getenv("DATASET_DIR")) pipeline_options.source_dir = dir;
+        if (const char* env_batch = std::getenv("PIPELINE_BATCH")) pipeline_options.batch_size = std::stoull(env_batch);
+        if (const char* env_min = std::getenv("PIPELINE_MIN_AGE")) pipeline_options.min_age = clamp_age_arg(std::stoll(env_min));
+        if (const char* env_max = std::getenv("PIPELINE_MAX_AGE")) pipeline_options.max_age = clamp_age_arg(std::stoll(env_max));
+
+        auto pipeline_start = high_resolution_clock::now();
+        PipelineAggregate aggregate;
+        const bool pipeline_ok = run_user_pipeline(pipeline_options, aggregate);
+        auto pipeline_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - pipeline_start);
+
+        std::cout << "🌀 COROUTINE PIPELINE (" << default_thread_pool().size() << " workers, "
+                  << pipeline_options.batch_size << " rows/batch, <= "
+                  << pipeline_batch_bound(pipeline_options) << " batches in flight):\n";
+        if (pipeline_ok) {
+            std::cout << "Rows: " << aggregate.rows << "\n";
+            std::cout << "Average age: " << (aggregate.rows ? aggregate.age_sum / aggregate.rows : 0) << "\n";
+            std::cout << "Elapsed time: " << pipeline_elapsed.count() / 1000000.0 << "ms\n\n";
+        }
+        if (std::string_view(env_pipeline) == "only") return pipeline_ok ? 0 : 1;
+    }
+    #endif
+
     std::cout << "User size: " << sizeof(User) << " bytes\n";
     std::cout << "Processing " << num_users << " users\n\n";
     
@@ -347,18 +6454,9 @@ int main() {
     std::vector<User> users;
     UserSoA user_soa;
     
-    users.reserve(num_users);
-    user_soa.reserve(num_users);
-    
-    for (size_t i = 0; i < num_users; ++i) {
-        int64_t id = static_cast<int64_t>(i);
-        std::string name = "User " + std::to_string(i);
-        uint8_t age = static_cast<uint8_t>(i % 100);
-        
-        users.emplace_back(User{id, name, age});
-        user_soa.add_user(id, name, age);
-    }
-    
+    prepare_dataset(user_soa, &users, num_users);
+    num_users = user_soa.size();
+
     // Тестируем AoS версию
     auto start = high_resolution_clock::now();
     uint64_t total_age_aos = 0;
@@ -454,7 +6552,654 @@ int main() {
     std::cout << "📚 STL PARALLEL VERSION (std::execution) 📚\n";
     std::cout << "Average age: " << avg_age_stl << "\n";
     std::cout << "Elapsed time: " << elapsed_stl.count() / 1000000.0 << "ms\n\n";
-    
+
+    // LAYOUTS=1: упакованный AoS и AoSoA-плитки против SoA - скан колонки и случайный доступ к строкам
+    if (std::getenv("LAYOUTS")) {
+        auto build_start = high_resolution_clock::now();
+        const UserPacked packed = UserPacked::from(user_soa);
+        const UserAoSoA tiled = UserAoSoA::from(user_soa);
+        auto build_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - build_start);
+
+        std::vector<size_t> probe_rows(std::min<size_t>(1000000, user_soa.size()));
+        std::mt19937_64 probe_rng(7);
+        std::uniform_int_distribution<size_t> pick_row(0, user_soa.size() - 1);
+        for (auto& row : probe_rows) row = pick_row(probe_rng);
+
+        std::cout << "🧱 LAYOUTS (built in " << build_elapsed.count() / 1000000.0 << "ms, "
+                  << probe_rows.size() << " random row reads):\n";
+        auto bench_layout = [&](const char* name, size_t bytes_per_row, const auto& layout) {
+            auto scan_start = high_resolution_clock::now();
+            const uint64_t total = sum_ages(layout);
+            const size_t adults = count_ages_in_range(layout, 18, 65);
+            const auto histogram = age_histogram(layout);
+            auto scan_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - scan_start);
+
+            auto rows_start = high_resolution_clock::now();
+            uint64_t checksum = 0;
+            for (size_t row : probe_rows) {
+                checksum += static_cast<uint64_t>(layout.id(row)) + layout.age(row) + layout.name(row).size();
+            }
+            auto rows_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - rows_start);
+
+            std::cout << name << " (" << bytes_per_row << " B/row): avg " << total / layout.size() << ", 18-65 " << adults << ", age 30 " << histogram[30]
+                      << ", scan " << scan_elapsed.count() / 1000000.0 << "ms, rows " << rows_elapsed.count() / 1000000.0
+                      << "ms (checksum " << checksum << ")\n";
+        };
+
+        bench_layout("SoA", sizeof(int64_t) + sizeof(std::string) + sizeof(uint8_t), user_soa);
+        bench_layout("Packed AoS", sizeof(PackedUser), packed);
+        bench_layout("AoSoA x64", sizeof(UserTile) / AOSOA_TILE_ROWS, tiled);
+        std::cout << "\n";
+    }
+
+    // TRANSPOSE=1: AoS ↔ SoA на разном числе полос - строки в секунду должны расти с ядрами
+    if (std::getenv("TRANSPOSE")) {
+        std::cout << "🔀 TRANSPOSE (" << parallel_backend_name(parallel_config().backend) << "):\n";
+        const size_t max_width = parallel_config().width;
+        for (size_t width = 1;; width = std::min(width * 2, max_width)) {
+            ParallelConfig config = parallel_config();
+            config.width = width;
+
+            auto to_soa_start = high_resolution_clock::now();
+            const UserSoA columns = users_to_soa(users, config);
+            auto to_soa_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - to_soa_start);
+
+            auto to_aos_start = high_resolution_clock::now();
+            const std::vector<User> rows = soa_to_users(columns, config);
+            auto to_aos_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - to_aos_start);
+
+            bool round_trip = columns.ids == user_soa.ids && columns.ages == user_soa.ages && columns.names == user_soa.names;
+            for (size_t i = 0; round_trip && i < rows.size(); ++i) {
+                round_trip = rows[i].id == users[i].id && rows[i].age == users[i].age && rows[i].name == users[i].name;
+            }
+
+            std::cout << width << " lanes: AoS→SoA "
+                      << num_users * 1000.0 / std::max<int64_t>(1, to_soa_elapsed.count()) << " Mrows/s, SoA→AoS "
+                      << num_users * 1000.0 / std::max<int64_t>(1, to_aos_elapsed.count()) << " Mrows/s"
+                      << (round_trip ? "" : " ❌ MISMATCH") << "\n";
+            if (width == max_width) break;
+        }
+        std::cout << "\n";
+    }
+
+    // INGEST=1: N продюсеров льют колонки пакетами - без мьютекса и с глобальным мьютексом
+    if (std::getenv("INGEST")) {
+        const size_t batch_rows = std::getenv("INGEST_BATCH") ? std::max<size_t>(1, std::stoull(std::getenv("INGEST_BATCH"))) : 4096;
+        const size_t max_producers = parallel_config().width;
+
+        // Продюсеры разбирают пакеты исходных строк через общий курсор
+        auto run_producers = [&](size_t producers, auto&& ingest_batch) {
+            std::atomic<size_t> cursor{0};
+            std::vector<std::thread> threads;
+            auto ingest_start = high_resolution_clock::now();
+            for (size_t p = 0; p < producers; ++p) {
+                threads.emplace_back([&] {
+                    for (;;) {
+                        const size_t begin = cursor.fetch_add(batch_rows, std::memory_order_relaxed);
+                        if (begin >= num_users) break;
+                        ingest_batch(begin, std::min(begin + batch_rows, num_users));
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            return duration_cast<nanoseconds>(high_resolution_clock::now() - ingest_start);
+        };
+
+        std::cout << "📥 CONCURRENT INGEST (batch " << batch_rows << " rows):\n";
+        for (size_t producers = 1;; producers = std::min(producers * 2, max_producers)) {
+            ConcurrentUserStore store(num_users);
+            // Строка хранилища = строка источника: снапшот обязан совпасть с префиксом user_soa
+            auto ingest_lock_free = [&](size_t begin, size_t end) {
+                const AppendRange range = store.reserve_rows(end - begin);
+                store.write_rows(range, user_soa, range.begin);
+                store.publish(range);
+            };
+            auto lock_free_elapsed = run_producers(producers, ingest_lock_free);
+
+            UserSoA locked;
+            locked.reserve(num_users);
+            std::mutex locked_mutex;
+            auto mutex_elapsed = run_producers(producers, [&](size_t begin, size_t end) {
+                std::lock_guard<std::mutex> lock(locked_mutex);
+                for (size_t i = begin; i < end; ++i) {
+                    locked.add_user(user_soa.ids[i], user_soa.names[i], user_soa.ages[i]);
+                }
+            });
+
+            const bool consistent = store.size() == num_users && sum_ages(store.snapshot()) == total_age_soa;
+            std::cout << producers << " producers: lock-free "
+                      << num_users * 1000.0 / std::max<int64_t>(1, lock_free_elapsed.count()) << " Mrows/s, mutex "
+                      << num_users * 1000.0 / std::max<int64_t>(1, mutex_elapsed.count()) << " Mrows/s"
+                      << (consistent ? "" : " ❌ MISMATCH") << "\n";
+            if (producers == max_producers) break;
+        }
+
+        // Скан снапшотов параллельно с ингестом: хранилище растёт с нуля, таблицы чанков уходят в retire
+        ConcurrentUserStore growing;
+        std::atomic<bool> ingest_done{false};
+        size_t snapshot_scans = 0;
+        bool snapshots_consistent = true;
+        std::thread scanner([&] {
+            while (!ingest_done.load(std::memory_order_acquire)) {
+                const UserStoreSnapshot snapshot = growing.snapshot();
+                const uint64_t expected = sum_u8_prefetch_range(user_soa.ages.data(), snapshot.size(), DEFAULT_PREFETCH_DISTANCE);
+                snapshots_consistent &= sum_ages(snapshot) == expected;
+                ++snapshot_scans;
+            }
+        });
+        auto growing_elapsed = run_producers(max_producers, [&](size_t begin, size_t end) {
+            const AppendRange range = growing.reserve_rows(end - begin);
+            growing.write_rows(range, user_soa, range.begin);
+            growing.publish(range);
+        });
+        ingest_done.store(true, std::memory_order_release);
+        scanner.join();
+        epoch_domain().reclaim();
+
+        std::cout << "📸 Snapshot scans during ingest: " << snapshot_scans << " scans, ingest "
+                  << num_users * 1000.0 / std::max<int64_t>(1, growing_elapsed.count()) << " Mrows/s, "
+                  << epoch_domain().pending() << " chunk tables pending reclaim"
+                  << (snapshots_consistent ? "" : " ❌ MISMATCH") << "\n\n";
+    }
+
+    // CHUNKED=1: рост колонок без reserve - вектор с переездами против сегментов
+    if (std::getenv("CHUNKED")) {
+        auto vector_start = high_resolution_clock::now();
+        UserSoA grown;
+        for (size_t i = 0; i < num_users; ++i) {
+            grown.add_user(user_soa.ids[i], user_soa.names[i], user_soa.ages[i]);
+        }
+        auto vector_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - vector_start);
+        const size_t vector_bytes = grown.ids.capacity() * sizeof(int64_t) + grown.ages.capacity() +
+                                    grown.names.capacity() * sizeof(std::string);
+
+        auto chunked_start = high_resolution_clock::now();
+        const ChunkedUserSoA chunked = ChunkedUserSoA::from(user_soa);
+        auto chunked_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - chunked_start);
+        const size_t chunked_bytes = chunked.ids.allocated_bytes() + chunked.ages.allocated_bytes() +
+                                     chunked.names.allocated_bytes();
+
+        auto scan_start = high_resolution_clock::now();
+        const uint64_t chunked_total = sum_u8_chunked(chunked.ages);
+        auto scan_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - scan_start);
+        const uint64_t chunked_adults = count_u8_in_range_chunked(chunked.ages, 18, 65);
+
+        std::cout << "🧩 CHUNKED COLUMNS (" << chunked.ages.chunk_count() << " chunks of " << COLUMN_CHUNK_ROWS << " rows):\n";
+        std::cout << "Vector growth: " << vector_elapsed.count() / 1000000.0 << "ms, "
+                  << vector_bytes / (1024 * 1024) << " MB capacity\n";
+        std::cout << "Chunked growth: " << chunked_elapsed.count() / 1000000.0 << "ms, "
+                  << chunked_bytes / (1024 * 1024) << " MB allocated\n";
+        std::cout << "Chunked scan: avg " << chunked_total / std::max<size_t>(1, chunked.size()) << ", 18-65 "
+                  << chunked_adults << ", " << scan_elapsed.count() / 1000000.0 << "ms"
+                  << (chunked_total == total_age_soa ? "" : " ❌ MISMATCH") << "\n\n";
+    }
+
+    // CHURN=1: удаления и обновления поверх колонок - маскированные сканы до и после уплотнения
+    if (std::getenv("CHURN")) {
+        MutableUserTable table;
+        table.append(user_soa);
+
+        auto timed_scans = [&](const char* label) {
+            const MutableTableSnapshot snapshot = table.snapshot();
+            auto scan_start = high_resolution_clock::now();
+            const LiveAggregate aggregate = sum_ages_live(snapshot);
+            auto scan_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - scan_start);
+            const uint64_t adults = count_ages_in_range_live(snapshot, 18, 65);
+            const auto histogram = age_histogram_live(snapshot);
+            std::cout << label << ": " << aggregate.live_rows << " live rows in " << snapshot.chunk_count()
+                      << " chunks, avg " << aggregate.age_sum / std::max<uint64_t>(1, aggregate.live_rows) << ", scan "
+                      << scan_elapsed.count() / 1000000.0 << "ms\n";
+            return std::make_tuple(aggregate, adults, histogram);
+        };
+
+        // Эталон по исходным колонкам: удалённые строки и обновлённые возраста
+        std::vector<uint8_t> expected_ages(user_soa.ages);
+        std::vector<bool> expected_deleted(num_users, false);
+        auto expect_matches = [&](const auto& scans) {
+            const auto& [aggregate, adults, histogram] = scans;
+            LiveAggregate expected;
+            uint64_t expected_adults = 0;
+            std::array<uint64_t, 256> expected_histogram{};
+            for (size_t i = 0; i < num_users; ++i) {
+                if (expected_deleted[i]) continue;
+                expected.age_sum += expected_ages[i];
+                ++expected.live_rows;
+                expected_adults += expected_ages[i] >= 18 && expected_ages[i] <= 65;
+                ++expected_histogram[expected_ages[i]];
+            }
+            return aggregate.age_sum == expected.age_sum && aggregate.live_rows == expected.live_rows &&
+                   adults == expected_adults && histogram == expected_histogram;
+        };
+
+        std::cout << "🪦 CHURN (compact threshold " << DEFAULT_COMPACT_THRESHOLD * 100 << "%):\n";
+        bool churn_ok = expect_matches(timed_scans("Fresh"));
+
+        // Волна 1: 10% удалений и обновление каждой 1000-й строки - ниже порога уплотнения
+        const size_t erased = table.erase_if([](int64_t id, uint8_t) { return id % 10 == 3; });
+        for (size_t i = 0; i < num_users; ++i) expected_deleted[i] = user_soa.ids[i] % 10 == 3;
+        size_t updated = 0;
+        {
+            const MutableTableSnapshot snapshot = table.snapshot();
+            for (size_t c = 0; c < snapshot.chunk_count(); ++c) {
+                for (size_t slot = 0; slot < snapshot.chunk_rows(c); slot += 1000) {
+                    const size_t row = c * MUTABLE_CHUNK_ROWS + slot;
+                    const uint8_t age = static_cast<uint8_t>((expected_ages[row] + 1) % 100);
+                    if (table.set_age(snapshot.row_ref(c, slot), age)) {
+                        expected_ages[row] = age;
+                        ++updated;
+                    }
+                }
+            }
+        }
+        std::cout << "Erased " << erased << ", updated " << updated << " in place\n";
+        churn_ok &= expect_matches(timed_scans("Churned"));
+
+        // Волна 2: ещё 20% - чанки переходят порог, фоновый поток их переписывает
+        table.erase_if([](int64_t id, uint8_t) { return id % 10 == 5 || id % 10 == 7; });
+        for (size_t i = 0; i < num_users; ++i) expected_deleted[i] = expected_deleted[i] || user_soa.ids[i] % 10 == 5 || user_soa.ids[i] % 10 == 7;
+        const size_t chunks_before = table.snapshot().chunk_count();
+        const auto compaction_deadline = steady_clock::now() + seconds(5);
+        while (table.compaction_count() < chunks_before && steady_clock::now() < compaction_deadline) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+        std::cout << "Compacted " << table.compaction_count() << " chunks in background\n";
+        churn_ok &= expect_matches(timed_scans("Compacted"));
+
+        std::cout << (churn_ok ? "✅ Masked aggregates match\n\n" : "❌ MISMATCH\n\n");
+    }
+
+    // SORT=1: радикс-сортировка по возрасту и обратно по id, против std::stable_sort
+    if (std::getenv("SORT")) {
+        std::cout << "🔢 RADIX SORT:\n";
+
+        auto by_age_start = high_resolution_clock::now();
+        const std::vector<uint32_t> by_age = sort_permutation(user_soa, UserColumn::Age);
+        auto by_age_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - by_age_start);
+
+        auto std_start = high_resolution_clock::now();
+        std::vector<uint32_t> std_by_age(num_users);
+        for (size_t i = 0; i < num_users; ++i) std_by_age[i] = static_cast<uint32_t>(i);
+        std::stable_sort(std_by_age.begin(), std_by_age.end(),
+                         [&](uint32_t a, uint32_t b) { return user_soa.ages[a] < user_soa.ages[b]; });
+        auto std_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - std_start);
+
+        auto permute_start = high_resolution_clock::now();
+        UserSoA sorted = permute_users(user_soa, by_age);
+        auto permute_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - permute_start);
+
+        std::cout << "By age (1 pass): " << by_age_elapsed.count() / 1000000.0 << "ms, std::stable_sort "
+                  << std_elapsed.count() / 1000000.0 << "ms" << (by_age == std_by_age ? "" : " ❌ MISMATCH") << "\n";
+        std::cout << "Permute into new store: " << permute_elapsed.count() / 1000000.0 << "ms\n";
+
+        // Отсортированная колонка: диапазон возрастов - два бинарных поиска вместо скана
+        auto range_start = high_resolution_clock::now();
+        const uint64_t adults = std::upper_bound(sorted.ages.begin(), sorted.ages.end(), uint8_t(65)) -
+                                std::lower_bound(sorted.ages.begin(), sorted.ages.end(), uint8_t(18));
+        auto range_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - range_start);
+        std::cout << "Ages 18-65 on sorted column: " << adults << " in " << range_elapsed.count() / 1000.0 << "us"
+                  << (adults == count_ages_in_range(user_soa, 18, 65) ? "" : " ❌ MISMATCH") << "\n";
+
+        // Обратно по id на месте - должен вернуться исходный порядок (id уникальны)
+        auto by_id_start = high_resolution_clock::now();
+        sort_users(sorted, UserColumn::Id);
+        auto by_id_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - by_id_start);
+        std::vector<int64_t> expected_ids(user_soa.ids);
+        std::sort(expected_ids.begin(), expected_ids.end());
+        std::cout << "By id (multi-pass) + in-place permute: " << by_id_elapsed.count() / 1000000.0 << "ms"
+                  << (sorted.ids == expected_ids && sum_ages(sorted) == total_age_soa ? "" : " ❌ MISMATCH") << "\n\n";
+    }
+
+    // TOPK=1: K самых старых / молодых / наибольших id против одного скана колонки (TOPK_K, по умолчанию 100)
+    if (std::getenv("TOPK")) {
+        const size_t k = std::getenv("TOPK_K") ? std::stoull(std::getenv("TOPK_K")) : 100;
+
+        auto scan_start = high_resolution_clock::now();
+        const uint64_t scan_total = sum_u8_prefetch_parallel(user_soa.ages);
+        auto scan_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - scan_start);
+        std::cout << "🏆 TOP-" << k << " (age column scan: " << scan_elapsed.count() / 1000000.0 << "ms, avg "
+                  << scan_total / std::max<size_t>(1, num_users) << "):\n";
+
+        auto run_top_k = [&](const char* label, UserColumn column, TopKOrder order) {
+            auto top_start = high_resolution_clock::now();
+            const std::vector<TopKUser> top = top_k_users(user_soa, column, k, order);
+            auto top_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - top_start);
+
+            // Эталон - partial_sort индексов по тому же порядку (ключ, затем строка)
+            std::vector<size_t> reference(num_users);
+            for (size_t i = 0; i < num_users; ++i) reference[i] = i;
+            const size_t kept = std::min(k, num_users);
+            std::partial_sort(reference.begin(), reference.begin() + kept, reference.end(), [&](size_t a, size_t b) {
+                if (column == UserColumn::Age) {
+                    return top_k_better(TopKEntry<uint8_t>{user_soa.ages[a], a}, TopKEntry<uint8_t>{user_soa.ages[b], b}, order);
+                }
+                return top_k_better(TopKEntry<int64_t>{user_soa.ids[a], a}, TopKEntry<int64_t>{user_soa.ids[b], b}, order);
+            });
+            bool matches = top.size() == kept;
+            for (size_t i = 0; matches && i < kept; ++i) matches = top[i].row == reference[i];
+
+            std::cout << label << ": " << top_elapsed.count() / 1000000.0 << "ms";
+            if (!top.empty()) std::cout << ", #1 " << top.front().name << " (id " << top.front().id << ", age " << int(top.front().age) << ")";
+            std::cout << (matches ? "" : " ❌ MISMATCH") << "\n";
+        };
+
+        run_top_k("Oldest", UserColumn::Age, TopKOrder::Largest);
+        run_top_k("Youngest", UserColumn::Age, TopKOrder::Smallest);
+        run_top_k("Largest ids", UserColumn::Id, TopKOrder::Largest);
+        std::cout << "\n";
+    }
+
+    // JOIN=1: пользователи ⋈ события по id (JOIN_EVENTS событий, по умолчанию 4 на пользователя, ~20% без пары)
+    if (std::getenv("JOIN")) {
+        const size_t num_events = std::getenv("JOIN_EVENTS") ? std::stoull(std::getenv("JOIN_EVENTS")) : 4 * num_users;
+        const int64_t max_id = *std::max_element(user_soa.ids.begin(), user_soa.ids.end());
+
+        std::vector<int64_t> event_user_ids(num_events);
+        std::mt19937_64 event_rng(42);
+        std::uniform_int_distribution<size_t> pick_user(0, num_users - 1);
+        size_t expected_hits = 0;
+        for (auto& user_id : event_user_ids) {
+            if (event_rng() % 5 == 0) {
+                user_id = max_id + 1 + static_cast<int64_t>(event_rng() % 1000);
+            } else {
+                user_id = user_soa.ids[pick_user(event_rng)];
+                ++expected_hits;
+            }
+        }
+
+        auto join_start = high_resolution_clock::now();
+        const JoinResult joined = hash_join(user_soa.ids.data(), num_users, event_user_ids.data(), num_events);
+        auto join_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - join_start);
+
+        // Поздняя материализация: возраст читается только для найденных пар
+        bool pairs_ok = joined.size() == expected_hits;
+        uint64_t joined_age_sum = 0;
+        for (size_t i = 0; i < joined.size(); ++i) {
+            pairs_ok &= user_soa.ids[joined.left_rows[i]] == event_user_ids[joined.right_rows[i]];
+            joined_age_sum += user_soa.ages[joined.left_rows[i]];
+        }
+
+        std::cout << "🔗 HASH JOIN (" << num_users << " users ⋈ " << num_events << " events):\n";
+        std::cout << "Matches: " << joined.size() << " in " << join_elapsed.count() / 1000000.0 << "ms ("
+                  << (num_users + num_events) * 1000.0 / std::max<int64_t>(1, join_elapsed.count()) << " Mrows/s), "
+                  << "avg age per event " << joined_age_sum / std::max<size_t>(1, joined.size())
+                  << (pairs_ok ? "" : " ❌ MISMATCH") << "\n\n";
+    }
+
+    // PACKED_IDS=1: id-колонка FOR/дельты + битовая упаковка против std::vector<int64_t>
+    if (std::getenv("PACKED_IDS")) {
+        auto encode_start = high_resolution_clock::now();
+        const PackedIdColumn packed_ids = PackedIdColumn::encode(user_soa.ids.data(), num_users);
+        auto encode_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - encode_start);
+
+        std::array<size_t, 3> encodings{};
+        for (size_t b = 0; b < packed_ids.block_count(); ++b) ++encodings[static_cast<size_t>(packed_ids.block(b).encoding)];
+        const size_t plain_bytes = num_users * sizeof(int64_t);
+
+        bool round_trip = true;
+        uint32_t offsets[ID_BLOCK_ROWS];
+        for (size_t b = 0; b < packed_ids.block_count() && round_trip; ++b) {
+            const IdBlock& block = packed_ids.block(b);
+            if (block.encoding == IdEncoding::Raw) continue;
+            decode_id_offsets(packed_ids, b, offsets);
+            for (size_t slot = 0; slot < packed_ids.block_rows(b); ++slot) {
+                round_trip &= block.base + static_cast<int64_t>(offsets[slot]) == user_soa.ids[b * ID_BLOCK_ROWS + slot];
+            }
+        }
+        for (size_t row = 0; row < num_users; row += 997) round_trip &= packed_ids[row] == user_soa.ids[row];
+
+        std::cout << "🗜️ PACKED IDS (" << ID_BLOCK_ROWS << "-row blocks):\n";
+        std::cout << "Encode: " << encode_elapsed.count() / 1000000.0 << "ms, " << plain_bytes << " -> "
+                  << packed_ids.compressed_bytes() << " bytes (" << plain_bytes / std::max<double>(1, packed_ids.compressed_bytes())
+                  << "x); blocks FOR/delta/raw: " << encodings[0] << "/" << encodings[1] << "/" << encodings[2]
+                  << (round_trip ? "" : " ❌ MISMATCH") << "\n";
+
+        const int64_t max_id = *std::max_element(user_soa.ids.begin(), user_soa.ids.end());
+        auto run_id_range = [&](const char* name, int64_t lo, int64_t hi) {
+            // Байты, которые читает сжатый скан: заголовки всех блоков + слова блоков на границе диапазона
+            size_t touched = packed_ids.block_count() * sizeof(IdBlock);
+            for (size_t b = 0; b < packed_ids.block_count(); ++b) {
+                const IdBlock& block = packed_ids.block(b);
+                if (block.encoding == IdEncoding::Raw) {
+                    touched += packed_ids.block_rows(b) * sizeof(int64_t);
+                } else if (block.base < lo || block.base + block.span > hi) {
+                    if (block.base <= hi && block.base + block.span >= lo) touched += block.bits * ID_BLOCK_LANES * sizeof(uint32_t);
+                }
+            }
+
+            auto plain_start = high_resolution_clock::now();
+            const uint64_t plain_hits = parallel_reduce(num_users, uint64_t(0), [&](size_t start, size_t end) {
+                return count_i64_in_range(user_soa.ids.data() + start, end - start, lo, hi);
+            }, std::plus<uint64_t>());
+            auto plain_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - plain_start);
+
+            auto packed_start = high_resolution_clock::now();
+            const uint64_t packed_hits = count_ids_in_range(packed_ids, lo, hi);
+            auto packed_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - packed_start);
+
+            auto fused_start = high_resolution_clock::now();
+            const IdRangeAggregate fused = sum_ages_for_id_range(packed_ids, user_soa.ages.data(), lo, hi);
+            auto fused_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - fused_start);
+
+            uint64_t expected_age_sum = 0;
+            for (size_t i = 0; i < num_users; ++i) {
+                if (user_soa.ids[i] >= lo && user_soa.ids[i] <= hi) expected_age_sum += user_soa.ages[i];
+            }
+
+            std::cout << name << " [" << lo << ", " << hi << "]: " << packed_hits << " ids, plain "
+                      << plain_elapsed.count() / 1000000.0 << "ms, packed " << packed_elapsed.count() / 1000000.0
+                      << "ms (" << plain_bytes / std::max<double>(1, touched) << "x fewer bytes); avg age "
+                      << fused.age_sum / std::max<uint64_t>(1, fused.rows) << " in " << fused_elapsed.count() / 1000000.0 << "ms"
+                      << (packed_hits == plain_hits && fused.rows == plain_hits && fused.age_sum == expected_age_sum ? "" : " ❌ MISMATCH")
+                      << "\n";
+        };
+        run_id_range("Range 1%", max_id / 2, max_id / 2 + max_id / 100);
+        run_id_range("Range 50%", max_id / 4 + 7, max_id / 4 * 3 + 7);
+
+        auto sum_start = high_resolution_clock::now();
+        const int64_t packed_sum = sum_ids(packed_ids);
+        auto sum_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - sum_start);
+        uint64_t plain_total = 0;
+        for (int64_t id : user_soa.ids) plain_total += static_cast<uint64_t>(id);
+        const int64_t plain_sum = static_cast<int64_t>(plain_total);
+        std::cout << "Sum of ids: " << packed_sum << " in " << sum_elapsed.count() / 1000000.0 << "ms"
+                  << (packed_sum == plain_sum ? "" : " ❌ MISMATCH") << "\n";
+
+        // Другие распределения: возрастающие id с пропусками (дельты по 2 бита) и
+        // перемешанные (FOR-блоки на полный размах - честный худший случай)
+        std::mt19937_64 id_rng(42);
+        std::vector<int64_t> gapped_ids(num_users);
+        for (size_t i = 0; i < num_users; ++i) gapped_ids[i] = static_cast<int64_t>(4 * i + id_rng() % 4);
+        std::vector<int64_t> shuffled_ids(user_soa.ids);
+        std::shuffle(shuffled_ids.begin(), shuffled_ids.end(), id_rng);
+
+        auto run_variant = [&](const char* name, const std::vector<int64_t>& ids) {
+            const PackedIdColumn column = PackedIdColumn::encode(ids.data(), num_users);
+            const int64_t lo = ids[num_users / 3], hi = lo + static_cast<int64_t>(num_users);
+            uint64_t expected_sum = 0, expected_age_sum = 0;
+            for (size_t i = 0; i < num_users; ++i) {
+                expected_sum += static_cast<uint64_t>(ids[i]);
+                if (ids[i] >= lo && ids[i] <= hi) expected_age_sum += user_soa.ages[i];
+            }
+            const uint64_t expected_hits = count_i64_in_range(ids.data(), num_users, lo, hi);
+            const IdRangeAggregate fused = sum_ages_for_id_range(column, user_soa.ages.data(), lo, hi);
+
+            bool ok = count_ids_in_range(column, lo, hi) == expected_hits && fused.rows == expected_hits &&
+                      fused.age_sum == expected_age_sum && sum_ids(column) == static_cast<int64_t>(expected_sum);
+            for (size_t row = 0; row < num_users; row += 997) ok &= column[row] == ids[row];
+            std::cout << name << ": " << plain_bytes / std::max<double>(1, column.compressed_bytes()) << "x"
+                      << (ok ? "" : " ❌ MISMATCH") << "\n";
+        };
+        run_variant("Gapped ids", gapped_ids);
+        run_variant("Shuffled ids", shuffled_ids);
+        std::cout << "\n";
+    }
+
+    // ХОЛОДНЫЕ ДАННЫЕ: перед каждым замером колонка выброшена из кэша
+    const size_t prefetch_distance = tune_prefetch_distance(user_soa.ages);
+
+    std::cout << "🧊 COLD DATA SCAN (prefetch distance: " << prefetch_distance << " bytes) 🧊\n";
+    auto run_cold = [&](const char* name, auto&& kernel) {
+        evict_from_cache(user_soa.ages);
+        auto cold_start = high_resolution_clock::now();
+        uint64_t total = kernel(user_soa.ages);
+        auto cold_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - cold_start);
+        std::cout << name << ": avg " << total / user_soa.ages.size() << ", "
+                  << cold_elapsed.count() / 1000000.0 << "ms" << (total == total_age_soa ? "" : " ❌ MISMATCH") << "\n";
+    };
+
+    run_cold("AVX2 (cold)", [](const auto& d) { return sum_u8_avx2(d); });
+    run_cold("PREFETCH (cold)", [&](const auto& d) { return sum_u8_prefetch(d, prefetch_distance); });
+    run_cold("STREAM (cold)", [&](const auto& d) { return sum_u8_stream(d, prefetch_distance); });
+    run_cold("PREFETCH PARALLEL (cold)", [&](const auto& d) { return sum_u8_prefetch_parallel(d, prefetch_distance); });
+    std::cout << "\n";
+
+    // PARALLEL BACKENDS: накладные расходы на запуск и масштабирование по числу полос
+    {
+        const ParallelConfig saved_config = parallel_config();
+        std::vector<size_t> widths;
+        for (size_t w = 1; w < saved_config.width; w *= 2) widths.push_back(w);
+        widths.push_back(saved_config.width);
+
+        // double-агрегат (сумма средних по 4K-блокам) должен совпасть побитово у всех бэкендов
+        auto block_mean_sum = [&](size_t start, size_t end) {
+            double total = 0;
+            for (size_t block = start; block < end; block += 4096) {
+                const size_t block_len = std::min<size_t>(4096, end - block);
+                total += static_cast<double>(sum_u8_prefetch_range(user_soa.ages.data() + block, block_len,
+                                                                   prefetch_distance)) / block_len;
+            }
+            return total;
+        };
+        std::vector<double> float_results;
+
+        std::cout << "⚙️ PARALLEL BACKENDS (active: " << parallel_backend_name(saved_config.backend) << "):\n";
+        for (ParallelBackend backend : available_parallel_backends()) {
+            parallel_config() = ParallelConfig{backend, saved_config.width};
+
+            constexpr int dispatch_rounds = 100;
+            auto dispatch_start = high_resolution_clock::now();
+            for (int r = 0; r < dispatch_rounds; ++r) {
+                parallel_reduce(saved_config.width, uint64_t(0), [](size_t, size_t) { return uint64_t(1); },
+                                std::plus<uint64_t>());
+            }
+            auto dispatch_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - dispatch_start);
+
+            std::cout << parallel_backend_name(backend) << ": overhead "
+                      << dispatch_elapsed.count() / 1000.0 / dispatch_rounds << "µs";
+            double single_ms = 0;
+            for (size_t width : widths) {
+                parallel_config().width = width;
+                auto scan_start = high_resolution_clock::now();
+                const uint64_t total = sum_u8_prefetch_parallel(user_soa.ages, prefetch_distance);
+                auto scan_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - scan_start);
+                const double scan_ms = scan_elapsed.count() / 1000000.0;
+                if (width == 1) single_ms = scan_ms;
+
+                std::cout << " | " << width << "T " << scan_ms << "ms";
+                if (width > 1) std::cout << " (" << single_ms / scan_ms << "x)";
+                if (total != total_age_ludicrous) std::cout << " ❌";
+            }
+            std::cout << "\n";
+
+            parallel_config().width = saved_config.width;
+            float_results.push_back(parallel_reduce(user_soa.ages.size(), 0.0, block_mean_sum, std::plus<double>()));
+        }
+        parallel_config() = saved_config;
+
+        const bool bit_identical = std::all_of(float_results.begin(), float_results.end(), [&](double value) {
+            return std::memcmp(&value, &float_results[0], sizeof(double)) == 0;
+        });
+        std::cout << "Floating-point reduction across backends: "
+                  << (bit_identical ? "bit-identical" : "❌ differs") << "\n\n";
+    }
+
+    // SHARED SCAN: avg, гистограмма и два фильтра - отдельными проходами и одним общим
+    {
+        const DatasetView view = DatasetView::of(user_soa);
+        const std::vector<QueryRequest> batch = {
+            make_query(1, QueryOp::AvgAge),
+            make_query(2, QueryOp::AgeHistogram),
+            make_query(3, QueryOp::CountAgeRange, 66, 255),
+            make_query(4, QueryOp::CountAgeRange, 18, 30),
+        };
+
+        auto separate_start = high_resolution_clock::now();
+        std::vector<QueryResult> separate;
+        for (const auto& request : batch) {
+            separate.push_back(execute_query(view, request));
+        }
+        auto separate_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - separate_start);
+
+        auto shared_start = high_resolution_clock::now();
+        const std::vector<QueryResult> shared = execute_query_batch(view, batch);
+        auto shared_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - shared_start);
+
+        bool same = true;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            same = same && separate[i].values == shared[i].values;
+        }
+
+        std::cout << "🔗 SHARED SCAN (" << batch.size() << " queries):\n";
+        std::cout << "Separate passes: " << separate_elapsed.count() / 1000000.0 << "ms\n";
+        std::cout << "One shared pass: " << shared_elapsed.count() / 1000000.0 << "ms"
+                  << (same ? "" : " ❌ results differ") << "\n\n";
+    }
+
+    // BUDGETED: сумма с дедлайном и с отменой из другого потока - частичный ответ и покрытие
+    {
+        std::cout << "⏱️ BUDGETED SCAN:\n";
+        auto report = [&](const std::string& label, const PartialScan<uint64_t>& scan, nanoseconds elapsed) {
+            std::cout << label << ": " << scan.coverage() * 100 << "% scanned, avg "
+                      << (scan.rows_scanned ? scan.value / scan.rows_scanned : 0) << ", "
+                      << elapsed.count() / 1000000.0 << "ms\n";
+        };
+
+        for (const nanoseconds budget : {nanoseconds(microseconds(100)), nanoseconds(milliseconds(1)), nanoseconds(milliseconds(10))}) {
+            auto budget_start = high_resolution_clock::now();
+            const auto scan = sum_u8_budgeted(user_soa.ages.data(), user_soa.ages.size(),
+                                              ScanControl::with_budget(budget), prefetch_distance);
+            auto budget_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - budget_start);
+            report("Budget " + std::to_string(budget.count() / 1000) + "us", scan, budget_elapsed);
+        }
+
+        std::atomic<bool> cancelled{false};
+        ScanControl control;
+        control.cancelled = &cancelled;
+        auto cancel_start = high_resolution_clock::now();
+        std::thread canceller([&cancelled] {
+            std::this_thread::sleep_for(microseconds(500));
+            cancelled.store(true, std::memory_order_relaxed);
+        });
+        const auto scan = sum_u8_budgeted(user_soa.ages.data(), user_soa.ages.size(), control, prefetch_distance);
+        auto cancel_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - cancel_start);
+        canceller.join();
+        report("Cancelled after 500us", scan, cancel_elapsed);
+        std::cout << "\n";
+    }
+
+    // APPROXIMATE: avg по случайной выборке блоков, уточняется раундами до APPROX_ERROR
+    {
+        ApproxOptions approx_options;
+        if (const char* env_error = std::getenv("APPROX_ERROR")) approx_options.target_error = std::stod(env_error);
+
+        std::cout << "🎲 APPROXIMATE AVG (target ±" << approx_options.target_error * 100 << "%, "
+                  << approx_options.confidence * 100 << "% CI):\n";
+        auto approx_start = high_resolution_clock::now();
+        const ApproxEstimate estimate = approx_aggregate(
+            user_soa.ages.data(), user_soa.ages.size(), ApproxMetric::SumAges, 0, 255, approx_options,
+            [&](const ApproxEstimate& e) {
+                const double half_width = (e.total_high - e.total_low) / 2 / std::max<size_t>(1, user_soa.ages.size());
+                std::cout << "  " << e.sampled_blocks << "/" << e.total_blocks << " blocks: avg " << e.mean
+                          << " ± " << half_width << "\n";
+                return true;
+            });
+        auto approx_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - approx_start);
+
+        std::cout << "Estimate: " << estimate.mean << (estimate.exact ? " (exact)" : "") << " vs exact "
+                  << static_cast<double>(total_age_ludicrous) / std::max<size_t>(1, user_soa.ages.size())
+                  << " in " << approx_elapsed.count() / 1000000.0 << "ms\n\n";
+    }
+
     // Находим самый быстрый
     std::vector<std::pair<std::string, uint64_t>> results = {
         {"AoS", elapsed_aos.count()},
@@ -509,12 +7254,60 @@ int main() {
     
     BlazingWriter writer("blazing_results_cpp.txt");
     for (const auto& [name, nanos] : results) {
-        writer.write_line(name + ": " + std::to_string(nanos / 1000000.0) + "ms");
+        writer.append(name).append(": ").append_fixed(nanos / 1000000.0, 6).append("ms").end_line();
     }
-    
+    writer.sync();
+
     auto file_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - file_start);
     std::cout << "Blazing file write time: " << file_elapsed.count() / 1000.0 << "µs\n\n";
-    
+
+    // Большой дамп: форматирование перекрывается с записью в async-режиме
+    if (const char* env_dump = std::getenv("DUMP_USERS")) {
+        const size_t dump_rows = std::min<size_t>(std::stoull(env_dump), user_soa.ids.size());
+        std::cout << "🚀💾 LARGE DUMP (" << dump_rows << " rows):\n";
+
+        const std::pair<const char*, BlazingWriter::Options> dump_modes[] = {
+            {"Sync", BlazingWriter::Options()},
+            {"Async", [] { BlazingWriter::Options o; o.async = true; return o; }()},
+            {"io_uring", [] { BlazingWriter::Options o; o.backend = IoBackend::IoUring; return o; }()},
+        };
+
+        for (const auto& [mode_name, dump_options] : dump_modes) {
+            auto dump_start = high_resolution_clock::now();
+            {
+                BlazingWriter dump("blazing_dump_cpp.txt", dump_options);
+                for (size_t i = 0; i < dump_rows; ++i) {
+                    dump.append_int(user_soa.ids[i]).append(',').append_uint(user_soa.ages[i]).end_line();
+                }
+            }
+            auto dump_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - dump_start);
+            std::cout << mode_name << " dump time: "
+                      << dump_elapsed.count() / 1000000.0 << "ms\n";
+        }
+        std::cout << "\n";
+    }
+
+    // EXPORT_CSV=path: параллельный экспорт таблицы (.tsv - с табуляцией)
+    if (const char* export_path = std::getenv("EXPORT_CSV")) {
+        CsvExportOptions export_options;
+        const std::string_view path_view(export_path);
+        if (path_view.size() >= 4 && path_view.substr(path_view.size() - 4) == ".tsv") {
+            export_options.delimiter = '\t';
+        }
+
+        auto export_start = high_resolution_clock::now();
+        bool exported = export_users_csv(export_path, user_soa, export_options);
+        auto export_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - export_start);
+
+        std::cout << "📤 CSV EXPORT:\n";
+        if (exported) {
+            std::cout << "Exported " << user_soa.ids.size() << " rows to " << export_path << " in "
+                      << export_elapsed.count() / 1000000.0 << "ms\n\n";
+        } else {
+            std::cout << "❌ Failed to export to " << export_path << "\n\n";
+        }
+    }
+
     std::cout << "🎯 C++ OPTIMIZATION SUMMARY:\n";
     std::cout << "• Template metaprogramming: compile-time optimizations\n";
     std::cout << "• AVX2 intrinsics: 256-bit SIMD operations\n";
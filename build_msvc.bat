@@ -17,7 +17,7 @@ echo.
 
 REM BLAZING FAST MSVC flags
 cl.exe blazing.cpp ^
-    /std:c++17 ^
+    /std:c++20 ^
     /O2 ^
     /Oi ^
     /Ot ^